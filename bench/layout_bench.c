@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime under -std=c99
+
+#include "layout.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Benchmark layout_split on data-sized splits (10^3 to 10^5 constraints)
+// Build and run with: make bench && ./bench/layout_bench
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mixed constraints, as generated for table columns or list rows
+static void make_mixed(Constraint *c, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    switch (i % 5) {
+    case 0:
+      c[i] = (Constraint)CONSTRAINT_LEN(1 + i % 3);
+      break;
+    case 1:
+      c[i] = (Constraint)CONSTRAINT_MIN_VAL(1);
+      break;
+    case 2:
+      c[i] = (Constraint)CONSTRAINT_MAX_VAL(2);
+      break;
+    case 3:
+      c[i] = (Constraint)CONSTRAINT_FILL_W(1 + i % 4);
+      break;
+    default:
+      c[i] = (Constraint)CONSTRAINT_PCT(0);
+      break;
+    }
+  }
+}
+
+// Fixed sizes that do not fit, with a few priority levels to shrink through
+static void make_overflow(Constraint *c, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    c[i] = (Constraint)CONSTRAINT_WITH_PRIORITY(CONSTRAINT_LEN(4), i % 4);
+  }
+}
+
+static void run(const char *name, void (*make)(Constraint *, size_t),
+                size_t n) {
+  Constraint *c = malloc(sizeof(Constraint) * n);
+  Rect *out = malloc(sizeof(Rect) * n);
+  if (!c || !out) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  make(c, n);
+
+  Rect area = rect_from_size(UINT16_MAX, 1);
+  size_t iterations = 0;
+  double start = now_sec();
+  double elapsed;
+  do {
+    if (layout_split(area, DIRECTION_HORIZONTAL, c, n, out) < 0) {
+      fprintf(stderr, "layout_split failed\n");
+      exit(1);
+    }
+    iterations++;
+    elapsed = now_sec() - start;
+  } while (elapsed < 0.2);
+
+  // Sanity check: the split always covers the whole axis
+  uint32_t covered = 0;
+  for (size_t i = 0; i < n; i++) {
+    covered += out[i].width;
+  }
+
+  printf("%-9s n=%-7zu %10.1f us/split %6.2f ns/constraint  covered=%u\n",
+         name, n, elapsed / iterations * 1e6, elapsed / iterations / n * 1e9,
+         covered);
+  free(c);
+  free(out);
+}
+
+int main(void) {
+  size_t sizes[] = {1000, 10000, 100000};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run("mixed", make_mixed, sizes[i]);
+  }
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run("overflow", make_overflow, sizes[i]);
+  }
+  return 0;
+}
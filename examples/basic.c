@@ -60,12 +60,14 @@ int main(void) {
 
   tty_enter_alternate_screen();
   tty_cursor_hide();
+  tty_enable_kitty_keyboard(KITTY_KBD_DISAMBIGUATE);
 
   int rows, cols;
   tty_get_size(&rows, &cols);
 
   Buffer *buf = buffer_create(rows, cols);
   if (!buf) {
+    tty_disable_kitty_keyboard();
     tty_cursor_show();
     tty_leave_alternate_screen();
     event_cleanup();
@@ -177,7 +179,10 @@ int main(void) {
         default:
           break;
         }
-        snprintf(status, sizeof(status), " Key: %s ", name);
+        snprintf(status, sizeof(status), " Key: %s%s%s%s ",
+                 (event.key.mod & MOD_CTRL) ? "Ctrl+" : "",
+                 (event.key.mod & MOD_ALT) ? "Alt+" : "",
+                 (event.key.mod & MOD_SHIFT) ? "Shift+" : "", name);
       }
       draw_screen(buf, rows, cols, status);
       break;
@@ -196,11 +201,15 @@ int main(void) {
       break;
 
     case EVENT_NONE:
+    case EVENT_TIMER:
+    case EVENT_FD:
+    case EVENT_MOUSE:
       break;
     }
   }
 
   buffer_destroy(buf);
+  tty_disable_kitty_keyboard();
   tty_cursor_show();
   tty_leave_alternate_screen();
   event_cleanup();
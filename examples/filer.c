@@ -13,6 +13,7 @@
 #define MAX_ENTRIES 256
 #define MAX_PATH 1024
 #define MAX_PREVIEW_SIZE (32 * 1024) // 32KB for preview text
+#define MAX_EVENTS 64
 
 typedef struct {
   char name[256];
@@ -25,6 +26,7 @@ typedef struct {
   size_t entry_count;
   size_t selected;
   char preview[MAX_PREVIEW_SIZE];
+  size_t preview_len;    // Bytes of text in preview
   size_t preview_scroll; // Scroll offset in lines
   char status[128];
   // Preview entries for directory preview
@@ -63,9 +65,9 @@ static void read_directory(AppState *s) {
 
     // Check if directory
     char fullpath[MAX_PATH];
-    snprintf(fullpath, sizeof(fullpath), "%s/%s", s->cwd, ent->d_name);
+    int n = snprintf(fullpath, sizeof(fullpath), "%s/%s", s->cwd, ent->d_name);
     struct stat st;
-    if (stat(fullpath, &st) == 0) {
+    if (n < (int)sizeof(fullpath) && stat(fullpath, &st) == 0) {
       s->entries[s->entry_count].is_dir = S_ISDIR(st.st_mode);
     } else {
       s->entries[s->entry_count].is_dir = 0;
@@ -83,6 +85,7 @@ static void read_directory(AppState *s) {
 // Read file preview
 static void read_preview(AppState *s) {
   s->preview[0] = '\0';
+  s->preview_len = 0;
   s->preview_scroll = 0;
   s->preview_entry_count = 0;
   s->preview_is_dir = 0;
@@ -102,9 +105,9 @@ static void read_preview(AppState *s) {
       s->preview_is_dir = 0; // Use text for special message
       return;
     }
-    snprintf(dirpath, sizeof(dirpath), "%s/%s", s->cwd, e->name);
+    int n = snprintf(dirpath, sizeof(dirpath), "%s/%s", s->cwd, e->name);
 
-    DIR *dir = opendir(dirpath);
+    DIR *dir = n < (int)sizeof(dirpath) ? opendir(dirpath) : NULL;
     if (!dir) {
       strcpy(s->preview, "[Cannot open directory]");
       s->preview_is_dir = 0;
@@ -123,9 +126,10 @@ static void read_preview(AppState *s) {
 
       // Check if directory
       char fullpath[MAX_PATH];
-      snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath, ent->d_name);
+      int n =
+          snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath, ent->d_name);
       struct stat st;
-      if (stat(fullpath, &st) == 0) {
+      if (n < (int)sizeof(fullpath) && stat(fullpath, &st) == 0) {
         s->preview_entries[s->preview_entry_count].is_dir = S_ISDIR(st.st_mode);
       } else {
         s->preview_entries[s->preview_entry_count].is_dir = 0;
@@ -143,9 +147,9 @@ static void read_preview(AppState *s) {
 
   // Regular file
   char fullpath[MAX_PATH];
-  snprintf(fullpath, sizeof(fullpath), "%s/%s", s->cwd, e->name);
+  int n = snprintf(fullpath, sizeof(fullpath), "%s/%s", s->cwd, e->name);
 
-  FILE *f = fopen(fullpath, "r");
+  FILE *f = n < (int)sizeof(fullpath) ? fopen(fullpath, "r") : NULL;
   if (!f) {
     strcpy(s->preview, "[Cannot read file]");
     return;
@@ -162,6 +166,7 @@ static void read_preview(AppState *s) {
     offset += len;
   }
   s->preview[offset] = '\0';
+  s->preview_len = offset;
 
   fclose(f);
 
@@ -238,18 +243,6 @@ static void build_preview_names(AppState *s) {
   }
 }
 
-// Get pointer to n-th line in preview (0-indexed)
-static const char *get_preview_line(AppState *s, size_t line) {
-  const char *p = s->preview;
-  for (size_t i = 0; i < line && *p; i++) {
-    while (*p && *p != '\n')
-      p++;
-    if (*p == '\n')
-      p++;
-  }
-  return p;
-}
-
 // Count total lines in preview
 static size_t count_preview_lines(AppState *s) {
   // For directory preview, return entry count
@@ -279,7 +272,10 @@ static Widget *preview_widget(AppState *s) {
     return LIST_COLORED(FILL, g_preview_names + offset,
                         g_preview_colors + offset, visible_count, (size_t)-1);
   }
-  return TEXT(FILL, get_preview_line(s, s->preview_scroll));
+  // Lines are drawn straight from the preview text, starting at the scroll
+  if (s->preview_len == 0)
+    return TEXT(FILL, s->preview); // Status message
+  return TEXT_SPAN(FILL, s->preview, s->preview_len, s->preview_scroll);
 }
 
 // Declarative view function
@@ -330,7 +326,8 @@ int main(void) {
   read_preview(&state);
 
   int running = 1;
-  Event event;
+  Event events[MAX_EVENTS];
+  int event_count;
 
   // Initial render
   ui_frame_begin();
@@ -338,79 +335,90 @@ int main(void) {
   ui_frame_end();
   buffer_render(buf);
 
-  while (running && event_poll(&event, -1) >= 0) {
+  while (running &&
+         (event_count = event_poll_batch(events, MAX_EVENTS, -1)) >= 0) {
     int needs_redraw = 0;
 
-    switch (event.type) {
-    case EVENT_KEY:
-      if (event.key.code == KEY_CHAR) {
-        // Ctrl+D: scroll preview down half page
-        if ((event.key.mod & MOD_CTRL) && event.key.ch == 'd') {
-          size_t total = count_preview_lines(&state);
-          size_t half_page = (rows - 4) / 2; // Approximate visible lines
-          if (state.preview_scroll + half_page < total) {
-            state.preview_scroll += half_page;
-          } else if (total > 0) {
-            state.preview_scroll = total - 1;
-          }
-          needs_redraw = 1;
-          break;
-        }
-        // Ctrl+U: scroll preview up half page
-        if ((event.key.mod & MOD_CTRL) && event.key.ch == 'u') {
-          size_t half_page = (rows - 4) / 2;
-          if (state.preview_scroll > half_page) {
-            state.preview_scroll -= half_page;
-          } else {
-            state.preview_scroll = 0;
+    // Fold the whole batch into state, then render once
+    for (int i = 0; i < event_count && running; i++) {
+      Event event = events[i];
+
+      switch (event.type) {
+      case EVENT_KEY:
+        if (event.key.code == KEY_CHAR) {
+          // Ctrl+D: scroll preview down half page
+          if ((event.key.mod & MOD_CTRL) && event.key.ch == 'd') {
+            size_t total = count_preview_lines(&state);
+            size_t half_page = (rows - 4) / 2; // Approximate visible lines
+            if (state.preview_scroll + half_page < total) {
+              state.preview_scroll += half_page;
+            } else if (total > 0) {
+              state.preview_scroll = total - 1;
+            }
+            needs_redraw = 1;
+            break;
           }
-          needs_redraw = 1;
-          break;
-        }
-        switch (event.key.ch) {
-        case 'q':
-          running = 0;
-          break;
-        case 'j': // Down
-          if (state.selected < state.entry_count - 1) {
-            state.selected++;
-            read_preview(&state);
+          // Ctrl+U: scroll preview up half page
+          if ((event.key.mod & MOD_CTRL) && event.key.ch == 'u') {
+            size_t half_page = (rows - 4) / 2;
+            if (state.preview_scroll > half_page) {
+              state.preview_scroll -= half_page;
+            } else {
+              state.preview_scroll = 0;
+            }
             needs_redraw = 1;
+            break;
           }
-          break;
-        case 'k': // Up
-          if (state.selected > 0) {
-            state.selected--;
-            read_preview(&state);
+          switch (event.key.ch) {
+          case 'q':
+            running = 0;
+            break;
+          case 'j': // Down
+            if (state.selected < state.entry_count - 1) {
+              state.selected++;
+              read_preview(&state);
+              needs_redraw = 1;
+            }
+            break;
+          case 'k': // Up
+            if (state.selected > 0) {
+              state.selected--;
+              read_preview(&state);
+              needs_redraw = 1;
+            }
+            break;
+          case 'h': // Parent directory
+            go_parent(&state);
             needs_redraw = 1;
+            break;
+          case 'l': // Enter directory
+            enter_dir(&state);
+            needs_redraw = 1;
+            break;
           }
-          break;
-        case 'h': // Parent directory
-          go_parent(&state);
-          needs_redraw = 1;
-          break;
-        case 'l': // Enter directory
-          enter_dir(&state);
-          needs_redraw = 1;
+        }
+        break;
+
+      case EVENT_RESIZE:
+        rows = event.resize.rows;
+        cols = event.resize.cols;
+        buffer_destroy(buf);
+        buf = buffer_create(rows, cols);
+        if (!buf) {
+          // Earlier events in the batch may have asked for a redraw
+          needs_redraw = 0;
+          running = 0;
           break;
         }
-      }
-      break;
+        needs_redraw = 1;
+        break;
 
-    case EVENT_RESIZE:
-      rows = event.resize.rows;
-      cols = event.resize.cols;
-      buffer_destroy(buf);
-      buf = buffer_create(rows, cols);
-      if (!buf) {
-        running = 0;
+      case EVENT_NONE:
+      case EVENT_TIMER:
+      case EVENT_FD:
+      case EVENT_MOUSE:
         break;
       }
-      needs_redraw = 1;
-      break;
-
-    case EVENT_NONE:
-      break;
     }
 
     if (needs_redraw) {
@@ -3,102 +3,479 @@
 #include "layout.h"
 #include "ttykit.h"
 #include "widget.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#define MAX_ENTRIES 4096
 #define MAX_LINE 1024
 #define MAX_QUERY 256
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536   // Bytes of stdin per read
+#define READ_BUDGET 1048576 // Bytes of stdin ingested per EVENT_FD, at most
+
+// Fuzzy scoring: every matched character scores, gaps between matched
+// characters cost, and a match at a word start, a camelCase hump or right
+// after another match earns a bonus
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY 8 // At the line start or after a separator
+#define BONUS_CAMEL 7    // Upper case after lower case, digit after non-digit
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FIRST_MULTIPLIER 2 // Applied to the first query character
 
 typedef struct {
-  char **lines;
+  char *text;
+  size_t len;
+  uint64_t mask; // char_bit of every character in text
+} Line;
+
+typedef struct {
+  Line *lines;
   size_t count;
   size_t capacity;
 } Lines;
 
+typedef struct {
+  size_t index; // Into all.lines
+  int score;
+  uint32_t end; // Just past where the pattern first completes in the line
+} Match;
+
+// Lower-cased query, ready to match
+typedef struct {
+  char chars[MAX_QUERY];
+  size_t len;
+  uint64_t mask;
+} Pattern;
+
+// Lines matching one prefix of the query, in input order
+typedef struct {
+  Match *matches;
+  size_t count;
+  size_t capacity;
+  size_t scanned; // Lines of all tested against the prefix so far
+} Level;
+
 typedef struct {
   Lines all;
-  const char *filtered[MAX_ENTRIES];
-  size_t filtered_count;
+  // levels[k] holds the lines that match the first k characters of
+  // levels_query; levels[depth] (the whole query) is the result set.
+  // levels[0] stores no matches: every line matches the empty prefix.
+  Level levels[MAX_QUERY];
+  size_t depth;
+  char levels_query[MAX_QUERY];
+  Match *top;     // Heap of the best top_cap matches, lowest ranked first
+  size_t top_count;
+  size_t top_cap; // Grows to cover the rows the list can show
+  Match *ranked;  // top sorted best first: what the list shows
+  int ranked_stale;
   size_t selected;
+  size_t scroll; // First visible row of the result list
   char query[MAX_QUERY];
   size_t cursor;
   char status[128];
+  int reading;            // stdin is still streaming in
+  char partial[MAX_LINE]; // Line whose newline has not arrived yet
+  size_t partial_len;
 } AppState;
 
-// Read lines from stdin
-static void read_stdin(Lines *lines) {
-  lines->capacity = 256;
-  lines->count = 0;
-  lines->lines = malloc(sizeof(char *) * lines->capacity);
-
-  char buf[MAX_LINE];
-  while (fgets(buf, sizeof(buf), stdin)) {
-    // Remove trailing newline
-    size_t len = strlen(buf);
-    if (len > 0 && buf[len - 1] == '\n') {
-      buf[len - 1] = '\0';
-      len--;
-    }
+static char lower(char c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+
+// Bit of a character (case-insensitive) in a line's character set
+// Letters and digits get a bit each; other bytes share the last 28.
+static uint64_t char_bit(char c) {
+  unsigned char u = (unsigned char)lower(c);
+  if (u >= 'a' && u <= 'z')
+    return (uint64_t)1 << (u - 'a');
+  if (u >= '0' && u <= '9')
+    return (uint64_t)1 << (26 + u - '0');
+  return (uint64_t)1 << (36 + u % 28);
+}
+
+// Append a line to all
+static int append_line(AppState *s, const char *text, size_t len) {
+  Lines *lines = &s->all;
+  if (lines->count >= lines->capacity) {
+    size_t capacity = lines->capacity ? lines->capacity * 2 : 256;
+    Line *grown = realloc(lines->lines, sizeof(Line) * capacity);
+    if (!grown)
+      return -1;
+    lines->lines = grown;
+    lines->capacity = capacity;
+  }
 
-    if (lines->count >= lines->capacity) {
-      lines->capacity *= 2;
-      lines->lines = realloc(lines->lines, sizeof(char *) * lines->capacity);
+  char *copy = malloc(len + 1);
+  if (!copy)
+    return -1;
+  uint64_t mask = 0;
+  for (size_t i = 0; i < len; i++) {
+    copy[i] = text[i];
+    mask |= char_bit(text[i]);
+  }
+  copy[len] = '\0';
+  lines->lines[lines->count++] = (Line){copy, len, mask};
+  return 0;
+}
+// Split a chunk of stdin into lines
+// Lines longer than MAX_LINE - 1 bytes are split, as fgets would.
+static int split_lines(AppState *s, const char *chunk, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (chunk[i] != '\n')
+      s->partial[s->partial_len++] = chunk[i];
+    if (chunk[i] == '\n' || s->partial_len == MAX_LINE - 1) {
+      if (append_line(s, s->partial, s->partial_len) == -1)
+        return -1;
+      s->partial_len = 0;
     }
+  }
+  return 0;
+}
 
-    lines->lines[lines->count] = strdup(buf);
-    lines->count++;
+// Read what stdin has ready (it is non-blocking), up to READ_BUDGET bytes
+// so keys are not held up behind a fast producer
+// Returns 0 while more may follow, -1 at EOF or on error
+static int read_stdin(AppState *s) {
+  static char chunk[READ_CHUNK];
+  for (size_t total = 0; total < READ_BUDGET;) {
+    ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+      return 0;
+    if (n <= 0) {
+      if (s->partial_len > 0)
+        append_line(s, s->partial, s->partial_len);
+      s->partial_len = 0;
+      return -1;
+    }
+    if (split_lines(s, chunk, n) == -1)
+      return -1;
+    total += n;
   }
+  return 0;
 }
 
 static void free_lines(Lines *lines) {
   for (size_t i = 0; i < lines->count; i++) {
-    free(lines->lines[i]);
+    free(lines->lines[i].text);
   }
   free(lines->lines);
 }
 
-// Simple substring match (case-insensitive)
-static int matches(const char *str, const char *query) {
-  if (query[0] == '\0')
-    return 1;
+// Pattern for the first len characters of query
+static void make_pattern(Pattern *p, const char *query, size_t len) {
+  p->len = 0;
+  p->mask = 0;
+  for (; p->len < len; p->len++) {
+    p->chars[p->len] = lower(query[p->len]);
+    p->mask |= char_bit(query[p->len]);
+  }
+}
 
-  size_t str_len = strlen(str);
-  size_t query_len = strlen(query);
-
-  for (size_t i = 0; i + query_len <= str_len; i++) {
-    int match = 1;
-    for (size_t j = 0; j < query_len; j++) {
-      char sc = str[i + j];
-      char qc = query[j];
-      if (sc >= 'A' && sc <= 'Z')
-        sc += 32;
-      if (qc >= 'A' && qc <= 'Z')
-        qc += 32;
-      if (sc != qc) {
-        match = 0;
-        break;
+// Bonus for matching text[i], given the character before it
+static int char_bonus(const char *text, size_t i) {
+  if (i == 0)
+    return BONUS_BOUNDARY;
+  char prev = text[i - 1];
+  char c = text[i];
+  if (prev == '/' || prev == '_' || prev == '-' || prev == '.' ||
+      prev == ' ' || prev == '\t')
+    return BONUS_BOUNDARY;
+  if ((prev >= 'a' && prev <= 'z' && c >= 'A' && c <= 'Z') ||
+      (!(prev >= '0' && prev <= '9') && c >= '0' && c <= '9'))
+    return BONUS_CAMEL;
+  return 0;
+}
+
+// Fuzzy match (case-insensitive): the pattern's characters in order
+// Lines missing any pattern character are rejected by their mask alone.
+// The match scored is the shortest window ending where the pattern first
+// completes: a forward scan finds the end, a backward one the start. The
+// forward scan resumes at m->end if the first done characters of the
+// pattern are known to complete there.
+// Returns 0 and sets m->score and m->end on a match, -1 otherwise
+static int fuzzy_score(const Line *line, const Pattern *p, size_t done,
+                       Match *m) {
+  if ((line->mask & p->mask) != p->mask)
+    return -1;
+  size_t from = done ? m->end : 0;
+  m->score = 0;
+  m->end = 0;
+  if (p->len == 0)
+    return 0;
+
+  const char *text = line->text;
+  size_t j = done;
+  size_t end = 0;
+  for (size_t i = from; i < line->len; i++) {
+    if (lower(text[i]) == p->chars[j] && ++j == p->len) {
+      end = i + 1;
+      break;
+    }
+  }
+  if (j < p->len)
+    return -1;
+  m->end = (uint32_t)end;
+
+  size_t start = end;
+  while (j > 0) {
+    start--;
+    if (lower(text[start]) == p->chars[j - 1])
+      j--;
+  }
+
+  // A run of consecutive matches keeps the bonus of its first character
+  int in_gap = 0;
+  int run_bonus = -1; // -1 outside a run
+  for (size_t i = start; i < end; i++) {
+    if (j < p->len && lower(text[i]) == p->chars[j]) {
+      int bonus = char_bonus(text, i);
+      if (run_bonus >= 0) {
+        if (bonus < run_bonus)
+          bonus = run_bonus;
+        if (bonus < BONUS_CONSECUTIVE)
+          bonus = BONUS_CONSECUTIVE;
+      } else {
+        run_bonus = bonus;
       }
+      if (j == 0)
+        bonus *= BONUS_FIRST_MULTIPLIER;
+      m->score += SCORE_MATCH + bonus;
+      in_gap = 0;
+      j++;
+    } else {
+      m->score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+      in_gap = 1;
+      run_bonus = -1;
     }
-    if (match)
-      return 1;
   }
   return 0;
 }
 
+// Whether a ranks above b: higher score, then shorter line, then earlier
+static int ranks_above(const Lines *all, Match a, Match b) {
+  if (a.score != b.score)
+    return a.score > b.score;
+  size_t a_len = all->lines[a.index].len;
+  size_t b_len = all->lines[b.index].len;
+  if (a_len != b_len)
+    return a_len < b_len;
+  return a.index < b.index;
+}
+
+// Restore the heap below i (lowest ranked at the root)
+static void sift_down(const Lines *all, Match *heap, size_t count, size_t i) {
+  for (;;) {
+    size_t low = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < count && ranks_above(all, heap[low], heap[left]))
+      low = left;
+    if (right < count && ranks_above(all, heap[low], heap[right]))
+      low = right;
+    if (low == i)
+      return;
+    Match tmp = heap[i];
+    heap[i] = heap[low];
+    heap[low] = tmp;
+    i = low;
+  }
+}
+
+// Offer a match to the top-K heap
+static void top_push(AppState *s, Match m) {
+  if (s->top_count < s->top_cap) {
+    size_t i = s->top_count++;
+    while (i > 0 && ranks_above(&s->all, s->top[(i - 1) / 2], m)) {
+      s->top[i] = s->top[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    s->top[i] = m;
+  } else if (s->top_cap > 0 && ranks_above(&s->all, m, s->top[0])) {
+    s->top[0] = m;
+    sift_down(&s->all, s->top, s->top_count, 0);
+  } else {
+    return;
+  }
+  s->ranked_stale = 1;
+}
+
+// Matches in level k
+static size_t level_count(const AppState *s, size_t k) {
+  return k == 0 ? s->all.count : s->levels[k].count;
+}
+
+// Match i of level k
+static Match level_match(const AppState *s, size_t k, size_t i) {
+  if (k == 0)
+    return (Match){i, 0, 0};
+  return s->levels[k].matches[i];
+}
+
+// Rebuild the top-K heap from the result level
+static void rank_results(AppState *s) {
+  s->top_count = 0;
+  size_t count = level_count(s, s->depth);
+  for (size_t i = 0; i < count; i++) {
+    top_push(s, level_match(s, s->depth, i));
+  }
+  s->ranked_stale = 1;
+}
+
+// Make the ranking cover the selection and the rows below it
+// K starts at the list height and doubles as the selection moves down;
+// growing it reranks the matches, not the lines. Only the K ranked
+// matches are ever sorted.
+static void rank_rows(AppState *s, size_t rows) {
+  size_t want = s->selected + rows;
+  if (want > s->top_cap && s->top_count == s->top_cap) {
+    size_t cap = s->top_cap ? s->top_cap : rows;
+    while (cap < want)
+      cap *= 2;
+    Match *top = realloc(s->top, sizeof(Match) * cap);
+    if (!top)
+      return;
+    s->top = top;
+    Match *ranked = realloc(s->ranked, sizeof(Match) * cap);
+    if (!ranked)
+      return;
+    s->ranked = ranked;
+    s->top_cap = cap;
+    rank_results(s);
+  }
+
+  // Heap sort a copy: the lowest ranked goes last
+  if (s->ranked_stale) {
+    size_t n = s->top_count;
+    memcpy(s->ranked, s->top, sizeof(Match) * n);
+    for (; n > 1; n--) {
+      Match tmp = s->ranked[0];
+      s->ranked[0] = s->ranked[n - 1];
+      s->ranked[n - 1] = tmp;
+      sift_down(&s->all, s->ranked, n - 1, 0);
+    }
+    s->ranked_stale = 0;
+  }
+}
+
+// Make room for n more matches in a level
+static int level_reserve(Level *level, size_t n) {
+  if (level->capacity - level->count >= n)
+    return 0;
+  size_t capacity = level->capacity ? level->capacity : 256;
+  while (capacity - level->count < n)
+    capacity *= 2;
+  Match *matches = realloc(level->matches, sizeof(Match) * capacity);
+  if (!matches)
+    return -1;
+  level->matches = matches;
+  level->capacity = capacity;
+  return 0;
+}
+
+// Test the lines that arrived since level k last scanned against the
+// first k query characters, offering the matches to the top-K heap if
+// rank is set
+// Returns -1 if out of memory (the lines are tested next time)
+static int level_scan_lines(AppState *s, size_t k, int rank) {
+  Level *level = &s->levels[k];
+  if (k == 0) {
+    for (; level->scanned < s->all.count; level->scanned++) {
+      if (rank)
+        top_push(s, level_match(s, 0, level->scanned));
+    }
+    return 0;
+  }
+  if (level_reserve(level, s->all.count - level->scanned) == -1)
+    return -1;
+
+  Pattern pattern;
+  make_pattern(&pattern, s->query, k);
+  for (; level->scanned < s->all.count; level->scanned++) {
+    Match m = {level->scanned, 0, 0};
+    if (fuzzy_score(&s->all.lines[m.index], &pattern, 0, &m) == 0) {
+      level->matches[level->count++] = m;
+      if (rank)
+        top_push(s, m);
+    }
+  }
+  return 0;
+}
+
+// Fill level k from the survivors of level k - 1: a line matching the
+// longer prefix also matches the shorter one, and the scan for the new
+// character starts where the shorter prefix completed
+// Returns -1 if out of memory
+static int level_extend(AppState *s, size_t k) {
+  size_t parent_count = level_count(s, k - 1);
+  Level *level = &s->levels[k];
+  level->count = 0;
+  level->scanned = k == 1 ? s->all.count : s->levels[k - 1].scanned;
+  if (level_reserve(level, parent_count) == -1)
+    return -1;
+
+  Pattern pattern;
+  make_pattern(&pattern, s->query, k);
+  for (size_t i = 0; i < parent_count; i++) {
+    Match m = level_match(s, k - 1, i);
+    if (fuzzy_score(&s->all.lines[m.index], &pattern, k - 1, &m) == 0)
+      level->matches[level->count++] = m;
+  }
+  return 0;
+}
+
+static size_t match_count(const AppState *s) {
+  return level_count(s, s->depth);
+}
+
+static void update_status(AppState *s) {
+  snprintf(s->status, sizeof(s->status), "%zu/%zu%s", match_count(s),
+           s->all.count, s->reading ? " (reading)" : "");
+}
+
+// Test the lines that arrived since the last scan against the query
+// Only the result level keeps up; the others catch up when popped back to.
+static void filter_new(AppState *s) {
+  level_scan_lines(s, s->depth, 1);
+  update_status(s);
+}
+
 // Filter entries based on query
+// The levels of the prefix an edit left alone are kept, so typing a
+// character filters only the previous results and backspace pops back to
+// a cached level. Levels an edit drops are freed.
 static void filter_entries(AppState *s) {
-  s->filtered_count = 0;
-  for (size_t i = 0; i < s->all.count && s->filtered_count < MAX_ENTRIES; i++) {
-    if (matches(s->all.lines[i], s->query)) {
-      s->filtered[s->filtered_count] = s->all.lines[i];
-      s->filtered_count++;
-    }
+  size_t len = strlen(s->query);
+  size_t depth = 0;
+  while (depth < s->depth && depth < len &&
+         s->levels_query[depth] == s->query[depth])
+    depth++;
+
+  for (size_t k = depth + 1; k <= s->depth; k++) {
+    free(s->levels[k].matches);
+    s->levels[k] = (Level){0};
   }
+  s->depth = depth;
+  level_scan_lines(s, depth, 0);
+  while (s->depth < len && level_extend(s, s->depth + 1) == 0) {
+    s->levels_query[s->depth] = s->query[s->depth];
+    s->depth++;
+  }
+
+  rank_results(s);
   s->selected = 0;
-  snprintf(s->status, sizeof(s->status), "%zu/%zu", s->filtered_count,
-           s->all.count);
+  s->scroll = 0;
+  update_status(s);
+}
+
+// Row provider for the result list: only visible rows are fetched
+static const char *match_line(void *userdata, size_t index, Color *fg) {
+  (void)fg;
+  AppState *s = userdata;
+  return s->all.lines[s->ranked[index].index].text;
 }
 
 // Insert character at cursor position
@@ -126,115 +503,183 @@ static void delete_char(AppState *s) {
   s->cursor--;
 }
 
+// Rows of the result list: the screen less the input, rules and status
+static size_t list_rows(int rows) { return rows > 4 ? (size_t)rows - 4 : 1; }
+
+// List widget of the last frame, for mapping clicks to items
+static Widget *g_list;
+
 // Declarative view function
 Widget *view(AppState *s) {
+  g_list = LIST_VIRTUAL(FILL, match_line, s, s->top_count, s->selected,
+                        &s->scroll);
   return VBOX(FILL, INPUT(LEN(1), s->query, s->cursor, "> "), HLINE(LEN(1)),
-              LIST(FILL, s->filtered, s->filtered_count, s->selected),
-              HLINE(LEN(1)), TEXT(LEN(1), s->status));
+              g_list, HLINE(LEN(1)), TEXT(LEN(1), s->status));
 }
 
 int main(void) {
-  // Read stdin before entering raw mode
-  Lines lines = {0};
-  read_stdin(&lines);
-
   if (tty_enable_raw_mode() == -1) {
     perror("tty_enable_raw_mode");
-    free_lines(&lines);
     return 1;
   }
 
   if (event_init() == -1) {
     tty_disable_raw_mode();
-    free_lines(&lines);
     return 1;
   }
 
   tty_enter_alternate_screen();
   tty_cursor_hide();
+  tty_enable_mouse(MOUSE_MODE_CLICK);
 
   int rows, cols;
   tty_get_size(&rows, &cols);
 
   Buffer *buf = buffer_create(rows, cols);
   if (!buf) {
+    tty_disable_mouse();
     tty_cursor_show();
     tty_leave_alternate_screen();
     event_cleanup();
     tty_disable_raw_mode();
-    free_lines(&lines);
     return 1;
   }
 
-  // Initialize state
+  // Initialize state; stdin streams in through the event loop while the
+  // UI is live (a tty on stdin has nothing to stream)
   AppState state = {0};
-  state.all = lines;
+  int flags = fcntl(STDIN_FILENO, F_GETFL);
+  if (!isatty(STDIN_FILENO) && flags != -1 &&
+      fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) != -1 &&
+      event_watch_fd(STDIN_FILENO, NULL) == 0)
+    state.reading = 1;
   filter_entries(&state);
 
   int running = 1;
-  Event event;
+  Event events[MAX_EVENTS];
+  int event_count;
   const char *selected = NULL;
 
   // Initial render
+  rank_rows(&state, list_rows(rows));
   ui_frame_begin();
   widget_render(view(&state), buf, rect_from_size(cols, rows));
   ui_frame_end();
   buffer_render(buf);
 
-  while (running && event_poll(&event, -1) >= 0) {
+  while (running &&
+         (event_count = event_poll_batch(events, MAX_EVENTS, -1)) >= 0) {
     int needs_redraw = 0;
     int needs_filter = 0;
 
-    switch (event.type) {
-    case EVENT_KEY:
-      if (event.key.code == KEY_ESCAPE) {
-        running = 0;
-      } else if (event.key.code == KEY_ENTER) {
-        if (state.filtered_count > 0) {
-          selected = state.filtered[state.selected];
+    // Fold the whole batch into state, then render once
+    for (int i = 0; i < event_count && running; i++) {
+      Event event = events[i];
+
+      // Typed characters only edit the query and input only adds lines;
+      // anything that looks at the results (Ctrl-N/P included) sees them
+      // filtered first
+      int edits_query =
+          event.type == EVENT_KEY &&
+          ((event.key.code == KEY_CHAR && !(event.key.mod & MOD_CTRL)) ||
+           event.key.code == KEY_BACKSPACE);
+      if (needs_filter && event.type != EVENT_FD && !edits_query) {
+        filter_entries(&state);
+        needs_filter = 0;
+      }
+
+      switch (event.type) {
+      case EVENT_KEY:
+        if (event.key.code == KEY_ESCAPE) {
+          running = 0;
+        } else if (event.key.code == KEY_ENTER) {
+          if (match_count(&state) > 0) {
+            rank_rows(&state, 1);
+            selected = state.all.lines[state.ranked[state.selected].index].text;
+            running = 0;
+          }
+        } else if (event.key.code == KEY_BACKSPACE) {
+          delete_char(&state);
+          needs_filter = 1;
+          needs_redraw = 1;
+        } else if (event.key.code == KEY_UP ||
+                   (event.key.code == KEY_CHAR && event.key.ch == 'p' &&
+                    (event.key.mod & MOD_CTRL))) {
+          if (state.selected > 0) {
+            state.selected--;
+            needs_redraw = 1;
+          }
+        } else if (event.key.code == KEY_DOWN ||
+                   (event.key.code == KEY_CHAR && event.key.ch == 'n' &&
+                    (event.key.mod & MOD_CTRL))) {
+          if (state.selected + 1 < match_count(&state)) {
+            state.selected++;
+            needs_redraw = 1;
+          }
+        } else if (event.key.code == KEY_CHAR) {
+          if (event.key.ch >= 32 && event.key.ch < 127) {
+            insert_char(&state, event.key.ch);
+            needs_filter = 1;
+            needs_redraw = 1;
+          }
+        }
+        break;
+
+      case EVENT_RESIZE:
+        rows = event.resize.rows;
+        cols = event.resize.cols;
+        buffer_destroy(buf);
+        buf = buffer_create(rows, cols);
+        if (!buf) {
+          // Earlier events in the batch may have asked for a redraw
+          needs_redraw = 0;
           running = 0;
+          break;
         }
-      } else if (event.key.code == KEY_BACKSPACE) {
-        delete_char(&state);
-        needs_filter = 1;
         needs_redraw = 1;
-      } else if (event.key.code == KEY_UP ||
-                 (event.key.code == KEY_CHAR && event.key.ch == 'p' &&
-                  (event.key.mod & MOD_CTRL))) {
-        if (state.selected > 0) {
-          state.selected--;
+        break;
+
+      case EVENT_MOUSE:
+        if (event.mouse.button == MOUSE_WHEEL_UP) {
+          size_t n = event.mouse.count;
+          state.selected = state.selected > n ? state.selected - n : 0;
           needs_redraw = 1;
-        }
-      } else if (event.key.code == KEY_DOWN ||
-                 (event.key.code == KEY_CHAR && event.key.ch == 'n' &&
-                  (event.key.mod & MOD_CTRL))) {
-        if (state.selected < state.filtered_count - 1) {
-          state.selected++;
+        } else if (event.mouse.button == MOUSE_WHEEL_DOWN) {
+          state.selected += event.mouse.count;
+          size_t count = match_count(&state);
+          if (state.selected >= count)
+            state.selected = count > 0 ? count - 1 : 0;
           needs_redraw = 1;
+        } else if (event.mouse.button == MOUSE_BUTTON_LEFT &&
+                   event.mouse.action == MOUSE_PRESS) {
+          Rect list;
+          if (widget_get_rect(g_list, &list) == 0 &&
+              widget_at(event.mouse.row, event.mouse.col) == g_list) {
+            size_t index = state.scroll + (event.mouse.row - list.y);
+            if (index < state.top_count) {
+              state.selected = index;
+              needs_redraw = 1;
+            }
+          }
         }
-      } else if (event.key.code == KEY_CHAR) {
-        if (event.key.ch >= 32 && event.key.ch < 127) {
-          insert_char(&state, event.key.ch);
-          needs_filter = 1;
-          needs_redraw = 1;
+        break;
+
+      case EVENT_FD:
+        if (read_stdin(&state) == -1) {
+          event_unwatch_fd(STDIN_FILENO);
+          state.reading = 0;
         }
-      }
-      break;
+        // New lines only extend the results; a pending query change
+        // rescans everything anyway
+        if (!needs_filter)
+          filter_new(&state);
+        needs_redraw = 1;
+        break;
 
-    case EVENT_RESIZE:
-      rows = event.resize.rows;
-      cols = event.resize.cols;
-      buffer_destroy(buf);
-      buf = buffer_create(rows, cols);
-      if (!buf) {
-        running = 0;
+      case EVENT_NONE:
+      case EVENT_TIMER:
         break;
       }
-      needs_redraw = 1;
-      break;
-
-    case EVENT_NONE:
-      break;
     }
 
     if (needs_filter) {
@@ -242,6 +687,7 @@ int main(void) {
     }
 
     if (needs_redraw) {
+      rank_rows(&state, list_rows(rows));
       buffer_clear(buf);
       ui_frame_begin();
       widget_render(view(&state), buf, rect_from_size(cols, rows));
@@ -251,6 +697,7 @@ int main(void) {
   }
 
   buffer_destroy(buf);
+  tty_disable_mouse();
   tty_cursor_show();
   tty_leave_alternate_screen();
   event_cleanup();
@@ -260,6 +707,11 @@ int main(void) {
     printf("%s\n", selected);
   }
 
-  free_lines(&lines);
+  for (size_t k = 0; k < MAX_QUERY; k++) {
+    free(state.levels[k].matches);
+  }
+  free(state.top);
+  free(state.ranked);
+  free_lines(&state.all);
   return selected ? 0 : 1;
 }
@@ -247,6 +247,9 @@ int main(void) {
       break;
 
     case EVENT_NONE:
+    case EVENT_TIMER:
+    case EVENT_FD:
+    case EVENT_MOUSE:
       break;
     }
 
@@ -252,6 +252,9 @@ int main(void) {
       break;
 
     case EVENT_NONE:
+    case EVENT_TIMER:
+    case EVENT_FD:
+    case EVENT_MOUSE:
       break;
     }
   }
@@ -1,6 +1,7 @@
 #include "buffer.h"
 #include "event.h"
 #include "layout.h"
+#include "ring.h"
 #include "ttykit.h"
 #include "widget.h"
 #include <stdio.h>
@@ -8,15 +9,21 @@
 #include <string.h>
 #include <time.h>
 
-#define HISTORY_SIZE 60
-#define MAX_PROCS 10
+#define HISTORY_SIZE 7200 // One hour of samples at REFRESH_MS
+#define NUM_PROCS 200
+#define REFRESH_MS 500
+#define LOG_LINES 1000
+#define LOG_BYTES (64 * 1024)
 
 typedef struct {
   double cpu_usage;
   double mem_usage;
-  double cpu_history[HISTORY_SIZE];
-  double mem_history[HISTORY_SIZE];
-  size_t history_count;
+  uint32_t metrics_version; // Bumped with every sample
+  TimeSeries *cpu_history; // Drawn decimated to the sparkline's width
+  TimeSeries *mem_history;
+  size_t proc_selected;
+  TableState procs;        // Process table scroll position and widths
+  LogRing *log;            // Newest samples, bounded however long it runs
   char status[128];
 } AppState;
 
@@ -38,77 +45,106 @@ static void update_metrics(AppState *s) {
   if (s->mem_usage > 0.9)
     s->mem_usage = 0.9;
 
-  // Shift history and add new values
-  if (s->history_count < HISTORY_SIZE) {
-    s->cpu_history[s->history_count] = s->cpu_usage;
-    s->mem_history[s->history_count] = s->mem_usage;
-    s->history_count++;
-  } else {
-    for (size_t i = 0; i < HISTORY_SIZE - 1; i++) {
-      s->cpu_history[i] = s->cpu_history[i + 1];
-      s->mem_history[i] = s->mem_history[i + 1];
-    }
-    s->cpu_history[HISTORY_SIZE - 1] = s->cpu_usage;
-    s->mem_history[HISTORY_SIZE - 1] = s->mem_usage;
-  }
+  // Add new values; the oldest drop out of the rings
+  time_series_push(s->cpu_history, s->cpu_usage);
+  time_series_push(s->mem_history, s->mem_usage);
+  s->metrics_version++;
+
+  char line[64];
+  time_t now = time(NULL);
+  size_t len = strftime(line, sizeof(line), "%H:%M:%S", localtime(&now));
+  len += snprintf(line + len, sizeof(line) - len, " cpu %5.1f%% mem %5.1f%%\n",
+                  s->cpu_usage * 100, s->mem_usage * 100);
+  log_ring_append(s->log, line, len);
 
-  snprintf(s->status, sizeof(s->status), "CPU: %.1f%% | MEM: %.1f%% | q:quit",
+  snprintf(s->status, sizeof(s->status),
+           "CPU: %.1f%% | MEM: %.1f%% | j/k:select h/l:scroll q:quit",
            s->cpu_usage * 100, s->mem_usage * 100);
 }
 
 // Process table data
 static const char *g_proc_headers[] = {"PID", "NAME", "CPU%", "MEM%"};
-static const char *g_proc_rows[MAX_PROCS][4];
-static const char **g_proc_row_ptrs[MAX_PROCS];
-static char g_proc_data[MAX_PROCS][4][32];
+static char g_proc_data[NUM_PROCS][4][32];
+static uint16_t g_proc_widths[4]; // Auto column widths, cached by the table
+static uint32_t g_proc_version;   // Bumped whenever g_proc_data changes
 
 static void init_proc_table(void) {
   // Fake process data
   const char *names[] = {"init",   "systemd", "bash",  "vim",    "htop",
                          "chrome", "firefox", "slack", "docker", "node"};
-  for (int i = 0; i < MAX_PROCS; i++) {
+  for (int i = 0; i < NUM_PROCS; i++) {
     snprintf(g_proc_data[i][0], 32, "%d", 1000 + i * 100);
-    snprintf(g_proc_data[i][1], 32, "%s", names[i]);
+    if (i < 10)
+      snprintf(g_proc_data[i][1], 32, "%s", names[i]);
+    else
+      snprintf(g_proc_data[i][1], 32, "%s-worker-%d", names[i % 10], i / 10);
     snprintf(g_proc_data[i][2], 32, "%.1f", (double)(rand() % 100) / 10.0);
     snprintf(g_proc_data[i][3], 32, "%.1f", (double)(rand() % 50) / 10.0);
-    for (int j = 0; j < 4; j++) {
-      g_proc_rows[i][j] = g_proc_data[i][j];
-    }
-    g_proc_row_ptrs[i] = g_proc_rows[i];
   }
 }
 
 static void update_proc_table(void) {
   // Update CPU/MEM values randomly
-  for (int i = 0; i < MAX_PROCS; i++) {
+  for (int i = 0; i < NUM_PROCS; i++) {
     snprintf(g_proc_data[i][2], 32, "%.1f", (double)(rand() % 100) / 10.0);
     snprintf(g_proc_data[i][3], 32, "%.1f", (double)(rand() % 50) / 10.0);
   }
+  g_proc_version++;
 }
 
-// Column widths for table
-static const uint16_t g_col_widths[] = {8, 12, 8, 8};
+// Table cell provider: only visible cells are requested
+static const char *proc_cell(void *userdata, size_t row, size_t col) {
+  (void)userdata;
+  return g_proc_data[row][col];
+}
 
 // Declarative view function
+// A grid keeps the dashboard columns aligned: the column split is solved
+// once and shared by every row. Each panel is VERSIONED, so a keypress
+// that only moves the table selection leaves the other panels' cells as
+// they were.
 Widget *view(AppState *s) {
-  return VBOX(
-      FILL,
+  uint32_t procs = widget_hash(WIDGET_HASH_INIT, &g_proc_version,
+                               sizeof(g_proc_version));
+  procs = widget_hash(procs, &s->proc_selected, sizeof(s->proc_selected));
+  procs = widget_hash(procs, &s->procs.col_offset, sizeof(s->procs.col_offset));
+  uint32_t status = widget_hash(WIDGET_HASH_INIT, s->status, strlen(s->status));
+
+  return GRID(
+      FILL, ((Constraint[]){LEN(5), FILL, LEN(6), LEN(1)}), 4,
+      ((Constraint[]){PCT(50), FILL}), 2,
       // CPU section
-      BLOCK(LEN(5), "CPU",
-            VBOX(FILL, GAUGE(LEN(1), s->cpu_usage, NULL, COLOR_INDEX(10)),
-                 SPARKLINE(FILL, s->cpu_history, s->history_count,
-                           COLOR_INDEX(10)))),
+      CELL(0, 0,
+           VERSIONED(s->metrics_version,
+                     BLOCK(FILL, "CPU",
+                           VBOX(FILL,
+                                GAUGE(LEN(1), s->cpu_usage, NULL,
+                                      COLOR_INDEX(10)),
+                                SPARKLINE_SERIES(FILL, s->cpu_history,
+                                                 COLOR_INDEX(10)))))),
       // Memory section
-      BLOCK(LEN(5), "Memory",
-            VBOX(FILL, GAUGE(LEN(1), s->mem_usage, NULL, COLOR_INDEX(12)),
-                 SPARKLINE(FILL, s->mem_history, s->history_count,
-                           COLOR_INDEX(12)))),
+      CELL(0, 1,
+           VERSIONED(s->metrics_version,
+                     BLOCK(FILL, "Memory",
+                           VBOX(FILL,
+                                GAUGE(LEN(1), s->mem_usage, NULL,
+                                      COLOR_INDEX(12)),
+                                SPARKLINE_SERIES(FILL, s->mem_history,
+                                                 COLOR_INDEX(12)))))),
       // Process table
-      BLOCK(FILL, "Processes",
-            TABLE(FILL, g_proc_headers, (const char ***)g_proc_row_ptrs, 4,
-                  MAX_PROCS, g_col_widths)),
+      CELL_SPAN(1, 0, 1, 2,
+                VERSIONED(procs, BLOCK(FILL, "Processes",
+                                       TABLE_VIRTUAL(FILL, g_proc_headers,
+                                                     proc_cell, NULL, 4,
+                                                     NUM_PROCS,
+                                                     s->proc_selected,
+                                                     &s->procs)))),
+      // Sample log, following the newest line
+      CELL_SPAN(2, 0, 1, 2,
+                VERSIONED((uint32_t)log_ring_total(s->log),
+                          BLOCK(FILL, "Log", LOG(FILL, s->log, NULL)))),
       // Status bar
-      TEXT(LEN(1), s->status));
+      CELL_SPAN(3, 0, 1, 2, VERSIONED(status, TEXT(FILL, s->status))));
 }
 
 int main(void) {
@@ -143,9 +179,38 @@ int main(void) {
   AppState state = {0};
   state.cpu_usage = 0.3;
   state.mem_usage = 0.5;
+  state.procs.widths = g_proc_widths;
+  state.cpu_history = time_series_create(HISTORY_SIZE);
+  state.mem_history = time_series_create(HISTORY_SIZE);
+  state.log = log_ring_create(LOG_LINES, LOG_BYTES);
+  if (!state.cpu_history || !state.mem_history || !state.log) {
+    time_series_destroy(state.cpu_history);
+    time_series_destroy(state.mem_history);
+    log_ring_destroy(state.log);
+    buffer_destroy(buf);
+    tty_cursor_show();
+    tty_leave_alternate_screen();
+    event_cleanup();
+    tty_disable_raw_mode();
+    return 1;
+  }
   init_proc_table();
   update_metrics(&state);
 
+  // Refresh metrics on a timer; keypresses no longer force an update. The
+  // loop blocks until an event, so without the timer nothing would refresh.
+  if (timer_add(REFRESH_MS, REFRESH_MS, NULL, NULL) == 0) {
+    time_series_destroy(state.cpu_history);
+    time_series_destroy(state.mem_history);
+    log_ring_destroy(state.log);
+    buffer_destroy(buf);
+    tty_cursor_show();
+    tty_leave_alternate_screen();
+    event_cleanup();
+    tty_disable_raw_mode();
+    return 1;
+  }
+
   int running = 1;
   Event event;
 
@@ -155,51 +220,76 @@ int main(void) {
   ui_frame_end();
   buffer_render(buf);
 
-  while (running) {
-    // Poll with 500ms timeout for auto-refresh
-    int ret = event_poll(&event, 500);
+  while (running && event_poll(&event, -1) >= 0) {
+    int needs_redraw = 0;
 
-    if (ret < 0) {
-      break;
-    }
-
-    if (ret > 0) {
-      switch (event.type) {
-      case EVENT_KEY:
-        if (event.key.code == KEY_CHAR && event.key.ch == 'q') {
-          running = 0;
-        } else if (event.key.code == KEY_ESCAPE) {
-          running = 0;
+    switch (event.type) {
+    case EVENT_KEY:
+      if (event.key.code == KEY_CHAR && event.key.ch == 'q') {
+        running = 0;
+      } else if (event.key.code == KEY_ESCAPE) {
+        running = 0;
+      } else if (event.key.code == KEY_DOWN ||
+                 (event.key.code == KEY_CHAR && event.key.ch == 'j')) {
+        if (state.proc_selected + 1 < NUM_PROCS) {
+          state.proc_selected++;
+          needs_redraw = 1;
         }
-        break;
-
-      case EVENT_RESIZE:
-        rows = event.resize.rows;
-        cols = event.resize.cols;
-        buffer_destroy(buf);
-        buf = buffer_create(rows, cols);
-        if (!buf) {
-          running = 0;
+      } else if (event.key.code == KEY_UP ||
+                 (event.key.code == KEY_CHAR && event.key.ch == 'k')) {
+        if (state.proc_selected > 0) {
+          state.proc_selected--;
+          needs_redraw = 1;
         }
-        break;
+      } else if (event.key.code == KEY_RIGHT ||
+                 (event.key.code == KEY_CHAR && event.key.ch == 'l')) {
+        state.procs.col_offset++; // Clamped by the table when drawn
+        needs_redraw = 1;
+      } else if (event.key.code == KEY_LEFT ||
+                 (event.key.code == KEY_CHAR && event.key.ch == 'h')) {
+        if (state.procs.col_offset > 0) {
+          state.procs.col_offset--;
+          needs_redraw = 1;
+        }
+      }
+      break;
 
-      case EVENT_NONE:
+    case EVENT_RESIZE:
+      rows = event.resize.rows;
+      cols = event.resize.cols;
+      buffer_destroy(buf);
+      buf = buffer_create(rows, cols);
+      if (!buf) {
+        running = 0;
         break;
       }
-    }
+      needs_redraw = 1;
+      break;
+
+    case EVENT_TIMER:
+      update_metrics(&state);
+      update_proc_table();
+      needs_redraw = 1;
+      break;
 
-    // Update metrics periodically
-    update_metrics(&state);
-    update_proc_table();
+    case EVENT_NONE:
+    case EVENT_MOUSE:
+    case EVENT_FD:
+      break;
+    }
 
-    // Redraw
-    buffer_clear(buf);
-    ui_frame_begin();
-    widget_render(view(&state), buf, rect_from_size(cols, rows));
-    ui_frame_end();
-    buffer_render(buf);
+    if (needs_redraw) {
+      buffer_clear(buf);
+      ui_frame_begin();
+      widget_render(view(&state), buf, rect_from_size(cols, rows));
+      ui_frame_end();
+      buffer_render(buf);
+    }
   }
 
+  time_series_destroy(state.cpu_history);
+  time_series_destroy(state.mem_history);
+  log_ring_destroy(state.log);
   buffer_destroy(buf);
   tty_cursor_show();
   tty_leave_alternate_screen();
@@ -9,6 +9,7 @@
 
 #define MAX_TASKS 100
 #define MAX_TASK_LEN 256
+#define MAX_EVENTS 64
 
 typedef struct {
   char text[MAX_TASK_LEN];
@@ -177,7 +178,8 @@ int main(void) {
   update_status(&state);
 
   int running = 1;
-  Event event;
+  Event events[MAX_EVENTS];
+  int event_count;
 
   // Initial render
   ui_frame_begin();
@@ -185,96 +187,107 @@ int main(void) {
   ui_frame_end();
   buffer_render(buf);
 
-  while (running && event_poll(&event, -1) >= 0) {
+  while (running &&
+         (event_count = event_poll_batch(events, MAX_EVENTS, -1)) >= 0) {
     int needs_redraw = 0;
 
-    switch (event.type) {
-    case EVENT_KEY:
-      if (state.input_mode) {
-        // Input mode
-        if (event.key.code == KEY_ESCAPE) {
-          state.input_mode = 0;
-          state.input[0] = '\0';
-          state.cursor = 0;
-          needs_redraw = 1;
-        } else if (event.key.code == KEY_ENTER) {
-          add_task(&state, state.input);
-          state.input_mode = 0;
-          state.input[0] = '\0';
-          state.cursor = 0;
-          needs_redraw = 1;
-        } else if (event.key.code == KEY_BACKSPACE) {
-          delete_char(&state);
-          needs_redraw = 1;
-        } else if (event.key.code == KEY_CHAR) {
-          if (event.key.ch >= 32 && event.key.ch < 127) {
-            insert_char(&state, event.key.ch);
-            needs_redraw = 1;
-          }
-        }
-      } else {
-        // Navigation mode
-        if (event.key.code == KEY_CHAR) {
-          switch (event.key.ch) {
-          case 'q':
-            running = 0;
-            break;
-          case 'a':
-            state.input_mode = 1;
+    // Fold the whole batch into state, then render once
+    for (int i = 0; i < event_count && running; i++) {
+      Event event = events[i];
+
+      switch (event.type) {
+      case EVENT_KEY:
+        if (state.input_mode) {
+          // Input mode
+          if (event.key.code == KEY_ESCAPE) {
+            state.input_mode = 0;
+            state.input[0] = '\0';
+            state.cursor = 0;
             needs_redraw = 1;
-            break;
-          case 'x':
-          case ' ':
-            toggle_task(&state);
+          } else if (event.key.code == KEY_ENTER) {
+            add_task(&state, state.input);
+            state.input_mode = 0;
+            state.input[0] = '\0';
+            state.cursor = 0;
             needs_redraw = 1;
-            break;
-          case 'd':
-            delete_task(&state);
+          } else if (event.key.code == KEY_BACKSPACE) {
+            delete_char(&state);
             needs_redraw = 1;
-            break;
-          case 'j':
+          } else if (event.key.code == KEY_CHAR) {
+            if (event.key.ch >= 32 && event.key.ch < 127) {
+              insert_char(&state, event.key.ch);
+              needs_redraw = 1;
+            }
+          }
+        } else {
+          // Navigation mode
+          if (event.key.code == KEY_CHAR) {
+            switch (event.key.ch) {
+            case 'q':
+              running = 0;
+              break;
+            case 'a':
+              state.input_mode = 1;
+              needs_redraw = 1;
+              break;
+            case 'x':
+            case ' ':
+              toggle_task(&state);
+              needs_redraw = 1;
+              break;
+            case 'd':
+              delete_task(&state);
+              needs_redraw = 1;
+              break;
+            case 'j':
+              if (state.selected < state.task_count - 1) {
+                state.selected++;
+                needs_redraw = 1;
+              }
+              break;
+            case 'k':
+              if (state.selected > 0) {
+                state.selected--;
+                needs_redraw = 1;
+              }
+              break;
+            }
+          } else if (event.key.code == KEY_DOWN) {
             if (state.selected < state.task_count - 1) {
               state.selected++;
               needs_redraw = 1;
             }
-            break;
-          case 'k':
+          } else if (event.key.code == KEY_UP) {
             if (state.selected > 0) {
               state.selected--;
               needs_redraw = 1;
             }
-            break;
-          }
-        } else if (event.key.code == KEY_DOWN) {
-          if (state.selected < state.task_count - 1) {
-            state.selected++;
-            needs_redraw = 1;
-          }
-        } else if (event.key.code == KEY_UP) {
-          if (state.selected > 0) {
-            state.selected--;
-            needs_redraw = 1;
+          } else if (event.key.code == KEY_ESCAPE) {
+            running = 0;
           }
-        } else if (event.key.code == KEY_ESCAPE) {
+        }
+        break;
+
+      case EVENT_RESIZE:
+        rows = event.resize.rows;
+        cols = event.resize.cols;
+        buffer_destroy(buf);
+        buf = buffer_create(rows, cols);
+        if (!buf) {
+          // Earlier events in the batch may have asked for a redraw
+          needs_redraw = 0;
           running = 0;
+          break;
         }
-      }
-      break;
+        needs_redraw = 1;
+        break;
 
-    case EVENT_RESIZE:
-      rows = event.resize.rows;
-      cols = event.resize.cols;
-      buffer_destroy(buf);
-      buf = buffer_create(rows, cols);
-      if (!buf) {
-        running = 0;
+      case EVENT_NONE:
+      case EVENT_TIMER:
+      case EVENT_FD:
+      case EVENT_MOUSE:
         break;
       }
-      needs_redraw = 1;
-      break;
-
-    case EVENT_NONE:
-      break;
     }
 
     if (needs_redraw) {
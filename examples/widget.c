@@ -108,6 +108,9 @@ int main(void) {
       break;
 
     case EVENT_NONE:
+    case EVENT_TIMER:
+    case EVENT_FD:
+    case EVENT_MOUSE:
       break;
     }
 
@@ -41,10 +41,23 @@ typedef struct {
   uint8_t attrs;
 } Cell;
 
+// Clip rectangle: rows [top, bottom) and columns [left, right)
+typedef struct {
+  int top;
+  int left;
+  int bottom;
+  int right;
+} BufferClip;
+
+#define BUFFER_CLIP_DEPTH 16 // Nested clips a buffer can hold
+
 typedef struct {
   Cell *cells;
   int rows;
   int cols;
+  BufferClip clip; // Every write is dropped outside it (starts as the buffer)
+  BufferClip clip_stack[BUFFER_CLIP_DEPTH]; // Clips saved by push
+  int clip_depth;
 } Buffer;
 
 Buffer *buffer_create(int rows, int cols);
@@ -61,4 +74,26 @@ void buffer_set_cell_styled(Buffer *buf, int row, int col, char ch, Color fg,
 void buffer_set_str_styled(Buffer *buf, int row, int col, const char *str,
                            Color fg, Color bg, uint8_t attrs);
 
+// Clip stack
+// Push narrows the clip to its intersection with a rectangle; pop restores
+// the previous one. buffer_clear ignores the clip.
+// Returns 0 on success, -1 if the stack is full (do not pop then)
+int buffer_push_clip(Buffer *buf, int row, int col, int height, int width);
+void buffer_pop_clip(Buffer *buf);
+
+// Span operations: the clip is computed once per call, then whole cells
+// are stored in a tight loop
+
+// Write len bytes of text (no NUL needed) into at most width cells
+// Tabs expand to the next multiple of 4 columns from col.
+void buffer_set_span(Buffer *buf, int row, int col, const char *text,
+                     size_t len, int width);
+void buffer_set_span_styled(Buffer *buf, int row, int col, const char *text,
+                            size_t len, int width, Color fg, Color bg,
+                            uint8_t attrs);
+
+// Fill height x width cells starting at (row, col) with one styled cell
+void buffer_fill_rect(Buffer *buf, int row, int col, int height, int width,
+                      char ch, Color fg, Color bg, uint8_t attrs);
+
 #endif // TTYKIT_BUFFER_H
@@ -1,13 +1,18 @@
 #ifndef TTYKIT_EVENT_H
 #define TTYKIT_EVENT_H
 
+#include "timer.h"
+#include <stddef.h>
 #include <stdint.h>
 
 // Event types
 typedef enum {
   EVENT_NONE = 0, // No event (timeout)
   EVENT_KEY,      // Key press
-  EVENT_RESIZE    // Terminal resize
+  EVENT_RESIZE,   // Terminal resize
+  EVENT_MOUSE,    // Mouse button, wheel or motion (see tty_enable_mouse)
+  EVENT_TIMER,    // Timer expired (see timer_add)
+  EVENT_FD        // Watched fd is readable (see event_watch_fd)
 } EventType;
 
 // Special keys
@@ -46,7 +51,10 @@ typedef enum {
   KEY_F9,
   KEY_F10,
   KEY_F11,
-  KEY_F12
+  KEY_F12,
+
+  // Recognized but unmapped escape sequence (consumed whole)
+  KEY_UNKNOWN
 } KeyCode;
 
 // Modifier flags
@@ -54,28 +62,79 @@ typedef enum {
   MOD_NONE = 0,
   MOD_CTRL = 1 << 0,
   MOD_ALT = 1 << 1,
-  MOD_SHIFT = 1 << 2
+  MOD_SHIFT = 1 << 2,
+  MOD_SUPER = 1 << 3
 } KeyMod;
 
+// Key action (repeat/release are only reported by the kitty keyboard
+// protocol with KITTY_KBD_EVENT_TYPES enabled)
+typedef enum {
+  KEY_ACTION_PRESS = 0,
+  KEY_ACTION_REPEAT,
+  KEY_ACTION_RELEASE
+} KeyAction;
+
 // Key event data
 typedef struct {
-  KeyCode code; // KEY_CHAR for regular chars, or special key
-  char ch;      // Character (valid when code == KEY_CHAR)
-  uint8_t mod;  // Modifier flags (MOD_CTRL, MOD_ALT, etc.)
+  KeyCode code;       // KEY_CHAR for regular chars, or special key
+  char ch;            // Character (valid when code == KEY_CHAR)
+  uint8_t mod;        // Modifier flags (MOD_CTRL, MOD_ALT, etc.)
+  uint8_t action;     // KeyAction (KEY_ACTION_PRESS unless kitty reports it)
+  uint32_t codepoint; // Unicode code point from kitty/modifyOtherKeys, or 0
 } KeyEvent;
 
+// Mouse buttons
+typedef enum {
+  MOUSE_BUTTON_LEFT = 0,
+  MOUSE_BUTTON_MIDDLE,
+  MOUSE_BUTTON_RIGHT,
+  MOUSE_BUTTON_NONE, // Motion with no button held
+  MOUSE_WHEEL_UP,
+  MOUSE_WHEEL_DOWN,
+  MOUSE_WHEEL_LEFT,
+  MOUSE_WHEEL_RIGHT
+} MouseButton;
+
+// Mouse actions (wheel notches are reported as presses)
+typedef enum { MOUSE_PRESS = 0, MOUSE_RELEASE, MOUSE_MOTION } MouseAction;
+
+// Mouse event data
+typedef struct {
+  uint8_t button; // MouseButton
+  uint8_t action; // MouseAction
+  uint8_t mod;    // Modifier flags (MOD_SHIFT, MOD_ALT, MOD_CTRL)
+  uint16_t count; // Wheel notches or motion reports coalesced into this one
+  int row;        // 0-based row
+  int col;        // 0-based column
+} MouseEvent;
+
 // Resize event data
 typedef struct {
   int rows;
   int cols;
 } ResizeEvent;
 
+// Timer event data
+typedef struct {
+  TimerId id;     // Timer that fired
+  void *userdata; // Userdata passed to timer_add
+} TimerEvent;
+
+// Fd event data
+typedef struct {
+  int fd;         // Readable fd (or at EOF)
+  void *userdata; // Userdata passed to event_watch_fd
+} FdEvent;
+
 // Unified event structure
 typedef struct {
   EventType type;
   union {
     KeyEvent key;
     ResizeEvent resize;
+    MouseEvent mouse;
+    TimerEvent timer;
+    FdEvent fd;
   };
 } Event;
 
@@ -85,9 +144,53 @@ int event_init(void);
 // Clean up event system
 void event_cleanup(void);
 
+// Input recording and replay
+// A recording holds the raw input bytes and resizes with timestamps, so a
+// session can be replayed byte for byte. Setting TTYKIT_RECORD=<path> or
+// TTYKIT_REPLAY=<path> makes event_init start one automatically
+// (TTYKIT_REPLAY_REALTIME=1 keeps the recorded timing).
+// Returns 0 on success, -1 on error
+int event_record_start(const char *path);
+void event_record_stop(void);
+
+// Replay a recording instead of reading the tty
+// realtime: 0 = full speed, timers run on the recorded clock
+//           1 = wait out the recorded gaps between inputs
+// event_poll returns -1 once the recording is exhausted.
+// Returns 0 on success, -1 on error
+int event_replay_start(const char *path, int realtime);
+void event_replay_stop(void);
+
+// Deliver an EVENT_RESIZE on the current context's next poll
+// For terminals whose size changes do not raise SIGWINCH in this process,
+// such as a pty driven by a server.
+void event_notify_resize(void);
+
+// Watched fds
+// event_poll waits on watched fds alongside the tty and reports each one
+// that is readable (or at EOF) as an EVENT_FD. The app does the reading;
+// an fd is reported again on every poll while it stays readable (once per
+// batch), so unwatch it at EOF. Readiness can be seen ahead of the report,
+// so read watched fds in non-blocking mode. Watches belong to the current
+// context.
+#define EVENT_MAX_FDS 8
+
+// Returns 0 on success, -1 if the fd is invalid or EVENT_MAX_FDS are watched
+int event_watch_fd(int fd, void *userdata);
+void event_unwatch_fd(int fd);
+
 // Poll for next event
 // timeout_ms: -1 = block forever, 0 = non-blocking, >0 = timeout in ms
+// Waits no longer than the nearest pending timer; expired timers run their
+// callbacks here and are returned as EVENT_TIMER.
 // Returns 1 if event received, 0 on timeout, -1 on error
 int event_poll(Event *event, int timeout_ms);
 
+// Poll for a batch of events
+// Waits up to timeout_ms for the first event, then collects every further
+// event that is available without blocking, so a burst of input (key
+// repeat, paste) can be folded into app state and rendered once.
+// Returns number of events stored (0 on timeout), or -1 on error
+int event_poll_batch(Event *out, size_t cap, int timeout_ms);
+
 #endif // TTYKIT_EVENT_H
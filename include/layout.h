@@ -31,17 +31,20 @@ typedef enum {
 // Size constraint
 typedef struct {
   ConstraintType type;
-  uint16_t value1; // Primary value
-  uint16_t value2; // Denominator for RATIO
+  uint16_t value1;  // Primary value
+  uint16_t value2;  // Denominator for RATIO
+  uint8_t priority; // Overflow priority: lower levels shrink first (0-255)
 } Constraint;
 
 // Helper macros for creating constraints
-#define CONSTRAINT_LEN(n) ((Constraint){CONSTRAINT_LENGTH, (n), 0})
-#define CONSTRAINT_PCT(n) ((Constraint){CONSTRAINT_PERCENT, (n), 0})
-#define CONSTRAINT_RATIO(a, b) ((Constraint){CONSTRAINT_RATIO, (a), (b)})
-#define CONSTRAINT_MIN_VAL(n) ((Constraint){CONSTRAINT_MIN, (n), 0})
-#define CONSTRAINT_MAX_VAL(n) ((Constraint){CONSTRAINT_MAX, (n), 0})
-#define CONSTRAINT_FILL_W(w) ((Constraint){CONSTRAINT_FILL, (w), 0})
+#define CONSTRAINT_LEN(n) ((Constraint){CONSTRAINT_LENGTH, (n), 0, 0})
+#define CONSTRAINT_PCT(n) ((Constraint){CONSTRAINT_PERCENT, (n), 0, 0})
+#define CONSTRAINT_RATIO(a, b) ((Constraint){CONSTRAINT_RATIO, (a), (b), 0})
+#define CONSTRAINT_MIN_VAL(n) ((Constraint){CONSTRAINT_MIN, (n), 0, 0})
+#define CONSTRAINT_MAX_VAL(n) ((Constraint){CONSTRAINT_MAX, (n), 0, 0})
+#define CONSTRAINT_FILL_W(w) ((Constraint){CONSTRAINT_FILL, (w), 0, 0})
+#define CONSTRAINT_WITH_PRIORITY(c, p)                                         \
+  ((Constraint){(c).type, (c).value1, (c).value2, (p)})
 
 // Create a Rect from width and height (positioned at origin)
 Rect rect_from_size(uint16_t width, uint16_t height);
@@ -53,8 +56,21 @@ int rect_is_empty(Rect r);
 Rect rect_intersection(Rect a, Rect b);
 
 // Split an area into multiple regions based on constraints
-// Returns 0 on success, -1 on error (overflow, invalid ratio, etc.)
+// When the fixed and minimum sizes do not fit, lower-priority constraints
+// are shrunk first (proportionally within a priority level), so the split
+// always fills the area instead of failing. out_rects doubles as the
+// solver's scratch, so no heap or stack space is used per constraint.
+// Returns 0 on success, -1 on error (invalid ratio)
 int layout_split(Rect area, Direction direction, const Constraint *constraints,
                  size_t num_constraints, Rect *out_rects);
 
+// Same as layout_split, but reuses the sizes solved by an earlier call with
+// the same axis size and constraints (small cross-frame cache)
+int layout_split_cached(Rect area, Direction direction,
+                        const Constraint *constraints, size_t num_constraints,
+                        Rect *out_rects);
+
+// Drop every cached split (call when the terminal is resized)
+void layout_cache_invalidate(void);
+
 #endif // TTYKIT_LAYOUT_H
@@ -0,0 +1,61 @@
+#ifndef TTYKIT_RING_H
+#define TTYKIT_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Log ring: the newest lines of an unbounded stream in fixed memory
+// Line text is stored back to back in one byte arena (a line never wraps
+// around its end) with a ring of offsets beside it. Appending is O(1) per
+// line and evicts the oldest lines until the new one fits.
+typedef struct LogRing LogRing;
+
+// Create a ring holding at most max_lines lines and max_bytes of text
+// Returns NULL on allocation failure or if either limit is 0
+LogRing *log_ring_create(size_t max_lines, size_t max_bytes);
+void log_ring_destroy(LogRing *ring);
+
+// Append text: each '\n' ends a line. Text after the last newline is
+// held back until a later append ends it, so raw read() chunks can be
+// passed as they come. Lines longer than max_bytes are cut to fit.
+void log_ring_append(LogRing *ring, const char *text, size_t len);
+
+// End the held-back text as a line, if there is any (at EOF)
+void log_ring_flush(LogRing *ring);
+
+// Lines currently held
+size_t log_ring_count(const LogRing *ring);
+
+// Lines appended since creation (the newest is number total - 1)
+uint64_t log_ring_total(const LogRing *ring);
+
+// Text of a line by number, not NUL-terminated
+// Returns NULL if the line was evicted or not appended yet
+const char *log_ring_line(const LogRing *ring, uint64_t number, size_t *len);
+
+// Time series ring: the newest samples of a metric in fixed memory
+// Pushing overwrites the oldest sample once the ring is full, in O(1).
+typedef struct TimeSeries TimeSeries;
+
+// Create a ring holding the newest capacity samples
+// Returns NULL on allocation failure or if capacity is 0
+TimeSeries *time_series_create(size_t capacity);
+void time_series_destroy(TimeSeries *series);
+
+void time_series_push(TimeSeries *series, double value);
+
+// Samples currently held
+size_t time_series_count(const TimeSeries *series);
+
+// Samples pushed since creation
+uint64_t time_series_total(const TimeSeries *series);
+
+// Held sample by index (0 = oldest held)
+double time_series_at(const TimeSeries *series, size_t index);
+
+// Smallest and largest of the count held samples starting at index first
+// Returns 0 on success, -1 if the range is empty or not held
+int time_series_range(const TimeSeries *series, size_t first, size_t count,
+                      double *min, double *max);
+
+#endif // TTYKIT_RING_H
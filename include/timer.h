@@ -0,0 +1,41 @@
+#ifndef TTYKIT_TIMER_H
+#define TTYKIT_TIMER_H
+
+#include <stdint.h>
+
+// Timer handle (0 = invalid)
+typedef uint32_t TimerId;
+
+// Timer callback, run from event_poll when the timer fires
+typedef void (*TimerCallback)(TimerId id, void *userdata);
+
+// Schedule a timer on the event loop
+// delay_ms: time until the first expiry
+// interval_ms: period for repeating timers (0 = one-shot)
+// cb: optional callback (NULL = only deliver EVENT_TIMER)
+// Returns timer id, or 0 on allocation failure
+TimerId timer_add(uint32_t delay_ms, uint32_t interval_ms, TimerCallback cb,
+                  void *userdata);
+
+// Cancel a pending timer (stale ids are ignored)
+// Returns 0 if cancelled, -1 if the timer was not pending
+int timer_cancel(TimerId id);
+
+// Event loop integration (used by event_poll)
+
+// Current time on the timer clock in milliseconds
+uint64_t timer_now_ms(void);
+
+// Replace the timer clock (NULL = monotonic clock)
+// Used by input replay to run timers on recorded time.
+void timer_set_clock(uint64_t (*clock)(void));
+
+// Milliseconds until the next timer expiry
+// Returns 0 if a timer has already expired, -1 if no timers are pending
+int timer_next_timeout(void);
+
+// Fire the next expired timer: runs its callback and re-arms it if periodic
+// Returns 1 if a timer fired (id/userdata filled in), 0 otherwise
+int timer_expire(TimerId *id, void **userdata);
+
+#endif // TTYKIT_TIMER_H
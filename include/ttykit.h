@@ -1,6 +1,30 @@
 #ifndef TTYKIT_H
 #define TTYKIT_H
 
+#include <stddef.h>
+
+// Contexts
+// Terminal, input and UI state (tty fd, input buffer, output and the cells
+// on screen, frame arena, layout and retained cells) belong to a context.
+// Every call acts on the current context, so one process can drive many
+// terminals (e.g. one pty per session) by making each one current in turn.
+// A default context on the controlling tty is current at startup. Timers,
+// input recording, render threads and the layout cache are shared by all
+// contexts.
+typedef struct TtykitCtx TtykitCtx;
+
+// Create a context that reads input from in_fd and writes output to
+// out_fd (often the same pty). The fds stay owned by the caller.
+// Returns NULL on allocation failure
+TtykitCtx *ttykit_ctx_create(int in_fd, int out_fd);
+
+// Destroy a context (the default one becomes current if ctx was)
+void ttykit_ctx_destroy(TtykitCtx *ctx);
+
+// Make ctx current (NULL = the default context)
+// Returns the previously current context (NULL if it was the default)
+TtykitCtx *ttykit_ctx_make_current(TtykitCtx *ctx);
+
 // Terminal raw mode
 int tty_enable_raw_mode(void);
 void tty_disable_raw_mode(void);
@@ -20,4 +44,40 @@ void tty_cursor_home(void);
 void tty_clear_screen(void);
 int tty_get_size(int *rows, int *cols);
 
+// buffer_render sends only the cells that changed since the last frame.
+// Clearing the screen, switching screens and resizing redraw the next frame
+// whole; call this after writing over the screen any other way.
+void tty_invalidate_screen(void);
+
+// Write raw bytes to the terminal
+void tty_write(const char *data, size_t len);
+
+// Kitty keyboard protocol flags (progressive enhancement)
+typedef enum {
+  KITTY_KBD_DISAMBIGUATE = 1 << 0,    // Escape codes for ambiguous keys
+  KITTY_KBD_EVENT_TYPES = 1 << 1,     // Report repeat and release events
+  KITTY_KBD_ALTERNATE_KEYS = 1 << 2,  // Report shifted key codes
+  KITTY_KBD_ALL_AS_ESCAPES = 1 << 3,  // Report every key as an escape code
+  KITTY_KBD_ASSOCIATED_TEXT = 1 << 4  // Report text generated by the key
+} KittyKeyboardFlags;
+
+// Keyboard protocols
+// Terminals that do not support a protocol ignore the request, and the
+// event parser accepts legacy and enhanced encodings at the same time.
+void tty_enable_kitty_keyboard(int flags);
+void tty_disable_kitty_keyboard(void);
+void tty_enable_modify_other_keys(void);
+void tty_disable_modify_other_keys(void);
+
+// Mouse reporting modes
+typedef enum {
+  MOUSE_MODE_CLICK = 0, // Press, release and wheel only
+  MOUSE_MODE_DRAG,      // Also motion while a button is held
+  MOUSE_MODE_MOTION     // Also motion with no button held
+} MouseMode;
+
+// Mouse reporting (SGR 1006 encoding, delivered as EVENT_MOUSE)
+void tty_enable_mouse(MouseMode mode);
+void tty_disable_mouse(void);
+
 #endif // TTYKIT_H
@@ -3,6 +3,7 @@
 
 #include "buffer.h"
 #include "layout.h"
+#include "ring.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -21,16 +22,57 @@ typedef enum {
   WIDGET_TABLE,
   WIDGET_CHECKBOX,
   WIDGET_PROGRESS,
-  WIDGET_TABS
+  WIDGET_TABS,
+  WIDGET_GRID,
+  WIDGET_LOG
 } WidgetType;
 
 // Forward declaration
 typedef struct Widget Widget;
 
+// Virtual list row provider: returns the text of item index (NULL = blank
+// row) and may set *fg, which starts as the default color
+typedef const char *(*ListItemFn)(void *userdata, size_t index, Color *fg);
+
+// Virtual table cell provider: returns the text of a body cell (NULL = empty)
+typedef const char *(*TableCellFn)(void *userdata, size_t row, size_t col);
+
+// Table view state, owned by the application and kept across frames
+// Zero-initialize. widths is optional storage for one entry per column;
+// when set, auto-sized widths are cached there (0 = not measured yet) and
+// only grow, so columns stay put while scrolling. Clear it when the data
+// is replaced.
+typedef struct {
+  size_t row_offset; // First visible row, moved to keep the selection visible
+  size_t col_offset; // First visible column (horizontal scroll)
+  uint16_t *widths;  // Optional auto width cache (col_count entries)
+} TableState;
+
+// Log view position, owned by the application and kept across frames
+// Zero-initialize to follow the tail. To scroll back, set hold and move
+// top; scrolling down to the newest lines follows the tail again.
+typedef struct {
+  uint64_t top; // Number of the first visible line, updated when drawn
+  int hold;     // Nonzero: stay at top instead of following new lines
+} LogState;
+
+// Grid cell placement (rows and columns are 0-based)
+typedef struct {
+  Widget *widget;
+  uint16_t row;
+  uint16_t col;
+  uint16_t row_span; // Rows covered (0 is treated as 1)
+  uint16_t col_span; // Columns covered (0 is treated as 1)
+} GridCell;
+
 // Widget structure
 struct Widget {
   WidgetType type;
   Constraint constraint;
+  uint32_t id;      // Index into the frame's layout (assigned at construction)
+  uint32_t key;     // Retained mode: match across frames (0 = by position)
+  uint32_t version; // Retained mode: bump when data behind pointers changes
+  int versioned;    // version alone stands for the subtree (VERSIONED)
   union {
     struct {
       Widget **children;
@@ -38,6 +80,8 @@ struct Widget {
     } box;
     struct {
       const char *text;
+      size_t length;     // Bytes of text (SIZE_MAX = up to the NUL)
+      size_t first_line; // Lines skipped before the first drawn row
     } text;
     struct {
       const char *title;
@@ -49,6 +93,10 @@ struct Widget {
           *colors; // Optional per-item foreground colors (NULL = default)
       size_t count;
       size_t selected;
+      ListItemFn item_fn; // Virtual list: fetches visible rows (NULL = items)
+      void *userdata;
+      size_t *scroll; // Optional first visible row, updated when drawn
+      size_t offset;  // *scroll when the widget was built
     } list;
     struct {
       const char *text;   // Current input text
@@ -61,9 +109,11 @@ struct Widget {
       Color color;       // Bar color
     } gauge;
     struct {
-      const double *data; // Array of values (0.0 to 1.0)
-      size_t count;       // Number of data points
-      Color color;        // Line color
+      const double *data;       // Array of values (0.0 to 1.0)
+      size_t count;             // Number of data points
+      Color color;              // Line color
+      const TimeSeries *series; // Ring read in place instead of data
+      uint64_t total;           // Samples pushed when the widget was built
     } sparkline;
     struct {
       const char **headers;   // Column headers
@@ -71,6 +121,12 @@ struct Widget {
       size_t col_count;       // Number of columns
       size_t row_count;       // Number of rows
       const uint16_t *widths; // Column widths (NULL = auto)
+      TableCellFn cell_fn;    // Virtual table: fetches visible cells
+      void *userdata;
+      size_t selected;   // Highlighted row (SIZE_MAX = none)
+      TableState *state; // Optional scroll and width cache, updated when drawn
+      size_t row_offset; // state offsets when the widget was built
+      size_t col_offset;
     } table;
     struct {
       const char **items; // Item labels
@@ -88,26 +144,64 @@ struct Widget {
       size_t count;        // Number of tabs
       size_t selected;     // Currently selected tab
     } tabs;
+    struct {
+      Constraint *rows; // Row heights, solved once for the whole grid
+      size_t row_count;
+      Constraint *cols; // Column widths, shared by every row
+      size_t col_count;
+      GridCell *cells; // Placed children
+      size_t count;
+    } grid;
+    struct {
+      const LogRing *ring;
+      LogState *state; // Optional scroll position (NULL = follow the tail)
+      uint64_t total;  // Ring lines appended when the widget was built
+      uint64_t top;    // state when the widget was built
+      int hold;
+    } log;
   };
 };
 
 // Constraint macros (use as first argument)
-#define LEN(n) ((Constraint){CONSTRAINT_LENGTH, (n), 0})
-#define PCT(n) ((Constraint){CONSTRAINT_PERCENT, (n), 0})
-#define FILL ((Constraint){CONSTRAINT_FILL, 1, 0})
-#define MIN(n) ((Constraint){CONSTRAINT_MIN, (n), 0})
-#define MAX(n) ((Constraint){CONSTRAINT_MAX, (n), 0})
+#define LEN(n) ((Constraint){CONSTRAINT_LENGTH, (n), 0, 0})
+#define PCT(n) ((Constraint){CONSTRAINT_PERCENT, (n), 0, 0})
+#define FILL ((Constraint){CONSTRAINT_FILL, 1, 0, 0})
+#define MIN(n) ((Constraint){CONSTRAINT_MIN, (n), 0, 0})
+#define MAX(n) ((Constraint){CONSTRAINT_MAX, (n), 0, 0})
+#define PRIO(c, p) CONSTRAINT_WITH_PRIORITY(c, p) // Keep longer when cramped
 
 // Layout widgets
 #define VBOX(c, ...) widget_vbox((c), (Widget *[]){__VA_ARGS__, NULL})
 #define HBOX(c, ...) widget_hbox((c), (Widget *[]){__VA_ARGS__, NULL})
 
+// Grid: rows/cols are Constraint arrays, followed by CELL/CELL_SPAN entries
+// e.g. GRID(FILL, ((Constraint[]){LEN(5), FILL}), 2,
+//           ((Constraint[]){PCT(50), FILL}), 2,
+//           CELL(0, 0, a), CELL(0, 1, b), CELL_SPAN(1, 0, 1, 2, c))
+#define GRID(c, rows, nrows, cols, ncols, ...)                                 \
+  widget_grid((c), (rows), (nrows), (cols), (ncols),                           \
+              (GridCell[]){__VA_ARGS__, {NULL, 0, 0, 0, 0}})
+#define CELL(r, c, w) ((GridCell){(w), (r), (c), 1, 1})
+#define CELL_SPAN(r, c, rs, cs, w) ((GridCell){(w), (r), (c), (rs), (cs)})
+
+// Retained mode: match this widget to last frame's widget with the same key
+#define KEYED(k, w) widget_set_key((w), (k))
+
+// Reuse last frame's cells for this widget's area (skipping the whole
+// subtree) while v and the area's size are unchanged, in any mode
+// v must change whenever anything drawn there would; see widget_hash.
+#define VERSIONED(v, w) widget_set_versioned((w), (v))
+
 // Content widgets
 #define TEXT(c, s) widget_text((c), (s))
+#define TEXT_SCROLL(c, s, line) widget_text_span((c), (s), SIZE_MAX, (line))
+#define TEXT_SPAN(c, s, len, line) widget_text_span((c), (s), (len), (line))
 #define BLOCK(c, t, ch) widget_block((c), (t), (ch))
 #define LIST(c, i, n, s) widget_list((c), (i), NULL, (n), (s))
 #define LIST_COLORED(c, i, colors, n, s)                                       \
   widget_list((c), (i), (colors), (n), (s))
+#define LIST_VIRTUAL(c, fn, userdata, n, s, scroll)                            \
+  widget_list_virtual((c), (fn), (userdata), (n), (s), (scroll))
 #define VLINE(c) widget_vline((c))
 #define HLINE(c) widget_hline((c))
 #define INPUT(c, text, cursor, prompt)                                         \
@@ -116,8 +210,14 @@ struct Widget {
   widget_gauge((c), (value), (label), (color))
 #define SPARKLINE(c, data, count, color)                                       \
   widget_sparkline((c), (data), (count), (color))
+#define SPARKLINE_SERIES(c, series, color)                                     \
+  widget_sparkline_series((c), (series), (color))
 #define TABLE(c, headers, rows, cols, row_cnt, widths)                         \
   widget_table((c), (headers), (rows), (cols), (row_cnt), (widths))
+#define TABLE_VIRTUAL(c, headers, fn, userdata, cols, row_cnt, sel, state)     \
+  widget_table_virtual((c), (headers), (fn), (userdata), (cols), (row_cnt),    \
+                       (sel), (state))
+#define LOG(c, ring, state) widget_log((c), (ring), (state))
 #define CHECKBOX(c, items, checked, count, selected)                           \
   widget_checkbox((c), (items), (checked), (count), (selected))
 #define PROGRESS(c, value, label, show_pct)                                    \
@@ -129,13 +229,51 @@ struct Widget {
 void ui_frame_begin(void);
 void ui_frame_end(void);
 
+// Frame arena usage
+typedef struct {
+  size_t used;          // Bytes allocated so far this frame
+  size_t high_water;    // Most bytes any frame has used
+  size_t capacity;      // Bytes held across all chunks (kept between frames)
+  size_t chunks;        // Chunks linked so far
+  size_t failed_allocs; // Allocations lost because malloc failed
+} ArenaStats;
+
+void ui_arena_stats(ArenaStats *stats);
+
+// Retained mode (off by default)
+// Each frame's tree is reconciled against the previous one, and subtrees
+// whose inputs (pointers, counts, selection, key, version) and size are
+// unchanged are copied from the last frame's cells instead of redrawn.
+// Data behind pointers is not inspected: after changing it in place, give
+// the widget a new version. Use one widget_render call per frame.
+// Frames with VERSIONED widgets are reconciled even when this is off, but
+// then only versioned subtrees (and boxes and grids around them) are
+// reused.
+void ui_set_retained(int enabled);
+
+// Parallel rendering (off by default)
+// widget_draw cuts the tree into subtrees with disjoint areas and draws
+// the costly ones on threads (counting the caller), with work stealing.
+// Providers and the state widgets write back are then used from several
+// threads at once: a provider shared by two widgets must not return one
+// static buffer. threads <= 1 turns it off.
+// Returns 0 on success, -1 if the threads could not be started
+int ui_set_render_threads(size_t threads);
+
 // Widget constructors (use macros instead)
 Widget *widget_vbox(Constraint c, Widget **children);
 Widget *widget_hbox(Constraint c, Widget **children);
+Widget *widget_grid(Constraint c, const Constraint *rows, size_t row_count,
+                    const Constraint *cols, size_t col_count,
+                    const GridCell *cells);
 Widget *widget_text(Constraint c, const char *text);
+Widget *widget_text_span(Constraint c, const char *text, size_t length,
+                         size_t first_line);
 Widget *widget_block(Constraint c, const char *title, Widget *child);
 Widget *widget_list(Constraint c, const char **items, const Color *colors,
                     size_t count, size_t selected);
+Widget *widget_list_virtual(Constraint c, ListItemFn item_fn, void *userdata,
+                            size_t count, size_t selected, size_t *scroll);
 Widget *widget_vline(Constraint c);
 Widget *widget_hline(Constraint c);
 Widget *widget_input(Constraint c, const char *text, size_t cursor,
@@ -144,9 +282,16 @@ Widget *widget_gauge(Constraint c, double value, const char *label,
                      Color color);
 Widget *widget_sparkline(Constraint c, const double *data, size_t count,
                          Color color);
+Widget *widget_sparkline_series(Constraint c, const TimeSeries *series,
+                                Color color);
 Widget *widget_table(Constraint c, const char **headers, const char ***rows,
                      size_t col_count, size_t row_count,
                      const uint16_t *widths);
+Widget *widget_table_virtual(Constraint c, const char **headers,
+                             TableCellFn cell_fn, void *userdata,
+                             size_t col_count, size_t row_count,
+                             size_t selected, TableState *state);
+Widget *widget_log(Constraint c, const LogRing *ring, LogState *state);
 Widget *widget_checkbox(Constraint c, const char **items, const int *checked,
                         size_t count, size_t selected);
 Widget *widget_progress(Constraint c, double value, const char *label,
@@ -154,10 +299,37 @@ Widget *widget_progress(Constraint c, double value, const char *label,
 Widget *widget_tabs(Constraint c, const char **labels, size_t count,
                     size_t selected);
 
+// Retained mode identity and data version (return w for chaining)
+Widget *widget_set_key(Widget *w, uint32_t key);
+Widget *widget_set_version(Widget *w, uint32_t version);
+Widget *widget_set_versioned(Widget *w, uint32_t version);
+
+// Content hash for VERSIONED: fold len bytes of data into hash (FNV-1a)
+// Start from WIDGET_HASH_INIT; chain calls to cover several fields.
+#define WIDGET_HASH_INIT 2166136261u
+uint32_t widget_hash(uint32_t hash, const void *data, size_t len);
+
 // Set selected index for list widget
 void widget_list_set_selected(Widget *w, size_t selected);
 
 // Rendering
+
+// Compute the area of every widget in the tree (iterative, no drawing)
+// Results stay valid until the next ui_frame_begin.
+// Returns 0 on success, -1 if the frame arena is exhausted
+int widget_layout(Widget *root, Rect area);
+
+// Draw the laid-out widgets in tree order (parents before children)
+void widget_draw(Buffer *buf);
+
+// Area assigned to a widget by the last widget_layout
+// Returns 0 on success, -1 if the widget was not laid out or has no area
+int widget_get_rect(const Widget *w, Rect *out);
+
+// Innermost laid-out widget covering a cell (NULL if none)
+Widget *widget_at(uint16_t row, uint16_t col);
+
+// Layout and draw in one call
 void widget_render(Widget *w, Buffer *buf, Rect area);
 
 #endif // TTYKIT_WIDGET_H
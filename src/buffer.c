@@ -1,9 +1,9 @@
+#include "context.h"
 #include "buffer.h"
 #include "ttykit.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 Buffer *buffer_create(int rows, int cols) {
   Buffer *buf = malloc(sizeof(Buffer));
@@ -17,6 +17,8 @@ Buffer *buffer_create(int rows, int cols) {
     free(buf);
     return NULL;
   }
+  buf->clip = (BufferClip){0, 0, rows, cols};
+  buf->clip_depth = 0;
 
   buffer_clear(buf);
   return buf;
@@ -30,12 +32,43 @@ void buffer_destroy(Buffer *buf) {
 }
 
 void buffer_clear(Buffer *buf) {
-  for (int i = 0; i < buf->rows * buf->cols; i++) {
-    buf->cells[i].ch = ' ';
-    buf->cells[i].fg = COLOR_DEFAULT_INIT;
-    buf->cells[i].bg = COLOR_DEFAULT_INIT;
-    buf->cells[i].attrs = ATTR_NONE;
-  }
+  BufferClip clip = buf->clip;
+  buf->clip = (BufferClip){0, 0, buf->rows, buf->cols};
+  buffer_fill_rect(buf, 0, 0, buf->rows, buf->cols, ' ', COLOR_DEFAULT_INIT,
+                   COLOR_DEFAULT_INIT, ATTR_NONE);
+  buf->clip = clip;
+}
+
+int buffer_push_clip(Buffer *buf, int row, int col, int height, int width) {
+  if (buf->clip_depth >= BUFFER_CLIP_DEPTH)
+    return -1;
+  buf->clip_stack[buf->clip_depth++] = buf->clip;
+
+  BufferClip *clip = &buf->clip;
+  if (row > clip->top)
+    clip->top = row;
+  if (col > clip->left)
+    clip->left = col;
+  if (height < 0)
+    height = 0;
+  if (width < 0)
+    width = 0;
+  if (row < clip->bottom - height)
+    clip->bottom = row + height;
+  if (col < clip->right - width)
+    clip->right = col + width;
+  return 0;
+}
+
+void buffer_pop_clip(Buffer *buf) {
+  if (buf->clip_depth > 0)
+    buf->clip = buf->clip_stack[--buf->clip_depth];
+}
+
+// Whether a cell is inside the clip (which lies inside the buffer)
+static int clip_contains(const Buffer *buf, int row, int col) {
+  return row >= buf->clip.top && row < buf->clip.bottom &&
+         col >= buf->clip.left && col < buf->clip.right;
 }
 
 Cell *buffer_get_cell(Buffer *buf, int row, int col) {
@@ -46,19 +79,14 @@ Cell *buffer_get_cell(Buffer *buf, int row, int col) {
 }
 
 void buffer_set_cell(Buffer *buf, int row, int col, char ch) {
-  Cell *cell = buffer_get_cell(buf, row, col);
-  if (cell) {
-    cell->ch = ch;
-    cell->fg = COLOR_DEFAULT_INIT;
-    cell->bg = COLOR_DEFAULT_INIT;
-    cell->attrs = ATTR_NONE;
-  }
+  buffer_set_cell_styled(buf, row, col, ch, COLOR_DEFAULT_INIT,
+                         COLOR_DEFAULT_INIT, ATTR_NONE);
 }
 
 void buffer_set_cell_styled(Buffer *buf, int row, int col, char ch, Color fg,
                             Color bg, uint8_t attrs) {
-  Cell *cell = buffer_get_cell(buf, row, col);
-  if (cell) {
+  if (clip_contains(buf, row, col)) {
+    Cell *cell = &buf->cells[row * buf->cols + col];
     cell->ch = ch;
     cell->fg = fg;
     cell->bg = bg;
@@ -69,40 +97,105 @@ void buffer_set_cell_styled(Buffer *buf, int row, int col, char ch, Color fg,
 #define TAB_WIDTH 4
 
 void buffer_set_str(Buffer *buf, int row, int col, const char *str) {
-  int start_col = col;
-  while (*str && col < buf->cols) {
-    if (*str == '\t') {
-      int spaces = TAB_WIDTH - ((col - start_col) % TAB_WIDTH);
-      for (int i = 0; i < spaces && col < buf->cols; i++) {
-        buffer_set_cell(buf, row, col, ' ');
-        col++;
-      }
-    } else {
-      buffer_set_cell(buf, row, col, *str);
-      col++;
-    }
-    str++;
-  }
+  buffer_set_str_styled(buf, row, col, str, COLOR_DEFAULT_INIT,
+                        COLOR_DEFAULT_INIT, ATTR_NONE);
 }
 
 void buffer_set_str_styled(Buffer *buf, int row, int col, const char *str,
                            Color fg, Color bg, uint8_t attrs) {
+  if (col >= buf->clip.right)
+    return;
+
+  // Every byte takes at least one cell, so nothing past the clip is read
+  size_t max = (size_t)buf->clip.right - col;
+  size_t len = 0;
+  while (len < max && str[len])
+    len++;
+  buffer_set_span_styled(buf, row, col, str, len, buf->clip.right - col, fg,
+                         bg, attrs);
+}
+
+void buffer_set_span(Buffer *buf, int row, int col, const char *text,
+                     size_t len, int width) {
+  buffer_set_span_styled(buf, row, col, text, len, width, COLOR_DEFAULT_INIT,
+                         COLOR_DEFAULT_INIT, ATTR_NONE);
+}
+
+// Store one cell into n consecutive cells with doubling block copies
+static void fill_cells(Cell *dst, size_t n, Cell cell) {
+  if (n == 0)
+    return;
+  dst[0] = cell;
+  for (size_t done = 1; done < n;) {
+    size_t chunk = done < n - done ? done : n - done;
+    memcpy(dst + done, dst, chunk * sizeof(Cell));
+    done += chunk;
+  }
+}
+
+void buffer_set_span_styled(Buffer *buf, int row, int col, const char *text,
+                            size_t len, int width, Color fg, Color bg,
+                            uint8_t attrs) {
+  if (row < buf->clip.top || row >= buf->clip.bottom || width <= 0)
+    return;
+
+  // Clip once to cells [left, stop) of the row, then store whole cells
   int start_col = col;
-  while (*str && col < buf->cols) {
-    if (*str == '\t') {
-      int spaces = TAB_WIDTH - ((col - start_col) % TAB_WIDTH);
-      for (int i = 0; i < spaces && col < buf->cols; i++) {
-        buffer_set_cell_styled(buf, row, col, ' ', fg, bg, attrs);
-        col++;
-      }
-    } else {
-      buffer_set_cell_styled(buf, row, col, *str, fg, bg, attrs);
-      col++;
+  int left = buf->clip.left;
+  int stop = col > buf->clip.right - width ? buf->clip.right : col + width;
+  Cell *line = &buf->cells[row * buf->cols];
+  Cell cell = {' ', fg, bg, attrs};
+  size_t i = 0;
+  while (i < len && col < stop) {
+    // Plain run up to the next tab (or the clip): style, then characters
+    size_t run = (size_t)(stop - col) < len - i ? (size_t)(stop - col)
+                                                : len - i;
+    const char *tab = memchr(text + i, '\t', run);
+    if (tab)
+      run = tab - (text + i);
+    size_t skip = col < left ? (size_t)(left - col) : 0;
+    if (skip < run) {
+      Cell *dst = line + col + skip;
+      fill_cells(dst, run - skip, cell);
+      for (size_t k = 0; k < run - skip; k++)
+        dst[k].ch = text[i + skip + k];
     }
-    str++;
+    i += run;
+    col += run;
+    if (!tab)
+      break;
+
+    // Expand the tab
+    int end = col + TAB_WIDTH - (col - start_col) % TAB_WIDTH;
+    if (end > stop)
+      end = stop;
+    int from = col < left ? left : col;
+    if (end > from)
+      fill_cells(line + from, end - from, cell);
+    col = end;
+    i++;
   }
 }
 
+void buffer_fill_rect(Buffer *buf, int row, int col, int height, int width,
+                      char ch, Color fg, Color bg, uint8_t attrs) {
+  if (height <= 0 || width <= 0)
+    return;
+
+  // Clip once
+  const BufferClip *clip = &buf->clip;
+  int top = row < clip->top ? clip->top : row;
+  int left = col < clip->left ? clip->left : col;
+  int bottom = row > clip->bottom - height ? clip->bottom : row + height;
+  int right = col > clip->right - width ? clip->right : col + width;
+
+  if (right <= left)
+    return;
+  Cell cell = {ch, fg, bg, attrs};
+  for (int r = top; r < bottom; r++)
+    fill_cells(&buf->cells[r * buf->cols + left], right - left, cell);
+}
+
 // Helper to check if two colors are equal
 static int color_eq(Color a, Color b) {
   if (a.type != b.type)
@@ -163,24 +256,42 @@ static int write_attr_escape(char *out, uint8_t attrs) {
   return pos;
 }
 
+static int cell_eq(const Cell *a, const Cell *b) {
+  return a->ch == b->ch && color_eq(a->fg, b->fg) && color_eq(a->bg, b->bg) &&
+         a->attrs == b->attrs;
+}
+
+// Worst case per cell: cursor move, reset, two RGB colors, every attribute
+#define RENDER_CELL_MAX 96
+
 void buffer_render(Buffer *buf) {
-  tty_cursor_home();
+  // Diff against the cells already on screen unless it must be redrawn
+  int valid;
+  Buffer *screen = tty_screen_frame(buf->rows, buf->cols, &valid);
+  if (!valid)
+    tty_cursor_home();
 
-  // Allocate generous buffer for output with escape sequences
-  // Each cell could need ~30 bytes for full color+attr sequences
-  size_t max_size = buf->rows * buf->cols * 32 + 64;
+  size_t max_size = (size_t)buf->rows * buf->cols * RENDER_CELL_MAX + 64;
   char *out = malloc(max_size);
-  if (!out)
+  if (!out) {
+    tty_invalidate_screen();
     return;
+  }
 
   int pos = 0;
   Color cur_fg = COLOR_DEFAULT_INIT;
   Color cur_bg = COLOR_DEFAULT_INIT;
   uint8_t cur_attrs = ATTR_NONE;
+  int at = valid ? -1 : 0; // Cell index under the cursor, -1 if unknown
 
   for (int r = 0; r < buf->rows; r++) {
     for (int c = 0; c < buf->cols; c++) {
-      Cell *cell = &buf->cells[r * buf->cols + c];
+      int i = r * buf->cols + c;
+      Cell *cell = &buf->cells[i];
+      if (valid && cell_eq(cell, &screen->cells[i]))
+        continue;
+      if (at != i)
+        pos += sprintf(out + pos, "\x1b[%d;%dH", r + 1, c + 1);
 
       // Check if style changed
       int fg_changed = !color_eq(cell->fg, cur_fg);
@@ -200,12 +311,17 @@ void buffer_render(Buffer *buf) {
       }
 
       out[pos++] = cell->ch;
+      at = i + 1; // Past the last column, autowrap lands on the next row
     }
   }
 
   // Reset attributes at the end
-  pos += sprintf(out + pos, "\x1b[0m");
-
-  write(STDOUT_FILENO, out, pos);
+  if (pos > 0) {
+    pos += sprintf(out + pos, "\x1b[0m");
+    tty_write(out, pos);
+  }
   free(out);
+
+  if (screen)
+    memcpy(screen->cells, buf->cells, sizeof(Cell) * buf->rows * buf->cols);
 }
@@ -0,0 +1,50 @@
+#include "context.h"
+#include "ttykit.h"
+#include <stdlib.h>
+
+struct TtykitCtx {
+  TtyState *tty;
+  InputState *input;
+  UiState *ui;
+};
+
+static TtykitCtx *g_current = NULL; // NULL = the default context
+
+TtykitCtx *ttykit_ctx_create(int in_fd, int out_fd) {
+  TtykitCtx *ctx = malloc(sizeof(TtykitCtx));
+  if (!ctx)
+    return NULL;
+
+  ctx->tty = tty_state_create(in_fd, out_fd);
+  ctx->input = input_state_create();
+  ctx->ui = ui_state_create();
+  if (!ctx->tty || !ctx->input || !ctx->ui) {
+    tty_state_destroy(ctx->tty);
+    input_state_destroy(ctx->input);
+    ui_state_destroy(ctx->ui);
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+void ttykit_ctx_destroy(TtykitCtx *ctx) {
+  if (!ctx)
+    return;
+  if (ctx == g_current)
+    ttykit_ctx_make_current(NULL);
+
+  tty_state_destroy(ctx->tty);
+  input_state_destroy(ctx->input);
+  ui_state_destroy(ctx->ui);
+  free(ctx);
+}
+
+TtykitCtx *ttykit_ctx_make_current(TtykitCtx *ctx) {
+  TtykitCtx *previous = g_current;
+  tty_state_bind(ctx ? ctx->tty : NULL);
+  input_state_bind(ctx ? ctx->input : NULL);
+  ui_state_bind(ctx ? ctx->ui : NULL);
+  g_current = ctx;
+  return previous;
+}
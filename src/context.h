@@ -0,0 +1,32 @@
+#ifndef TTYKIT_CONTEXT_H
+#define TTYKIT_CONTEXT_H
+
+#include "buffer.h"
+
+// Per-context state of each module (internal)
+// Each module keeps its state behind a pointer to the current instance;
+// binding NULL selects the module's built-in default instance.
+
+typedef struct TtyState TtyState;     // terminal.c: fds, termios, screen
+typedef struct InputState InputState; // event.c: unparsed input
+typedef struct UiState UiState;       // widget.c: frame arena and layout
+
+TtyState *tty_state_create(int in_fd, int out_fd);
+void tty_state_destroy(TtyState *state);
+void tty_state_bind(TtyState *state);
+
+// The current context's record of the cells on screen, for buffer_render
+// to diff against. Returns a rows x cols buffer (NULL if out of memory) and
+// sets *valid to 0 if the screen must be redrawn whole. The caller copies
+// its frame into the buffer after drawing it.
+Buffer *tty_screen_frame(int rows, int cols, int *valid);
+
+InputState *input_state_create(void);
+void input_state_destroy(InputState *state);
+void input_state_bind(InputState *state);
+
+UiState *ui_state_create(void);
+void ui_state_destroy(UiState *state);
+void ui_state_bind(UiState *state);
+
+#endif // TTYKIT_CONTEXT_H
@@ -1,10 +1,16 @@
+#define _POSIX_C_SOURCE 200809L // sigaction under -std=c99
+
+#include "context.h"
 #include "event.h"
 #include "ttykit.h"
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
 #include <unistd.h>
 
+// SIGWINCH reports the controlling tty, which the default context drives
 static volatile sig_atomic_t resize_pending = 0;
 
 static void sigwinch_handler(int sig) {
@@ -20,141 +26,353 @@ int event_init(void) {
   if (sigaction(SIGWINCH, &sa, NULL) == -1) {
     return -1;
   }
+
+  // Record or replay a session without changing the app
+  const char *record_path = getenv("TTYKIT_RECORD");
+  if (record_path && event_record_start(record_path) == -1) {
+    return -1;
+  }
+  const char *replay_path = getenv("TTYKIT_REPLAY");
+  if (replay_path &&
+      event_replay_start(replay_path, getenv("TTYKIT_REPLAY_REALTIME") !=
+                                          NULL) == -1) {
+    return -1;
+  }
   return 0;
 }
 
-void event_cleanup(void) { signal(SIGWINCH, SIG_DFL); }
+void event_cleanup(void) {
+  event_record_stop();
+  event_replay_stop();
+  signal(SIGWINCH, SIG_DFL);
+}
+
+// Input buffer: bytes read from the tty but not yet parsed into events
+#define INPUT_BUF_SIZE 256
+
+// How long to wait for the rest of a split escape sequence
+#define ESC_TIMEOUT_MS 25
+
+typedef struct {
+  int fd;
+  void *userdata;
+  int ready; // Readable at the last wait, not yet reported
+} WatchedFd;
+
+struct InputState {
+  char buf[INPUT_BUF_SIZE];
+  int len;
+  int resize_pending; // Set by event_notify_resize
+  WatchedFd watched[EVENT_MAX_FDS];
+  int watched_count;
+};
+
+static InputState g_default_input;
+static InputState *g_input = &g_default_input;
+
+InputState *input_state_create(void) {
+  return calloc(1, sizeof(InputState));
+}
+
+void input_state_destroy(InputState *state) {
+  if (state && g_input == state)
+    g_input = &g_default_input;
+  free(state);
+}
+
+void input_state_bind(InputState *state) {
+  g_input = state ? state : &g_default_input;
+}
+
+// CSI parser limits
+#define CSI_MAX_PARAMS 8
+#define CSI_MAX_SUBPARAMS 4
+#define CSI_MAX_LEN 64
+
+// Parsed control sequence: ESC [ <prefix> <params> <intermediate> <final>
+typedef struct {
+  char prefix;       // Private marker ('<', '=', '>', '?') or 0
+  char intermediate; // Last intermediate byte (0x20-0x2f) or 0
+  char final;        // Final byte (0x40-0x7e)
+  int count;         // Number of parameters
+  uint32_t params[CSI_MAX_PARAMS][CSI_MAX_SUBPARAMS]; // 0 = omitted
+} CsiSeq;
+
+// Final byte -> key for ESC [ <mods> X and ESC O X sequences
+static const uint8_t letter_keys[128] = {
+    ['A'] = KEY_UP,  ['B'] = KEY_DOWN, ['C'] = KEY_RIGHT, ['D'] = KEY_LEFT,
+    ['H'] = KEY_HOME, ['F'] = KEY_END,  ['P'] = KEY_F1,    ['Q'] = KEY_F2,
+    ['R'] = KEY_F3,  ['S'] = KEY_F4,   ['Z'] = KEY_TAB, // Z = Shift+Tab
+};
+
+// First parameter -> key for ESC [ <num> ; <mods> ~ sequences
+static const uint8_t tilde_keys[35] = {
+    [1] = KEY_HOME,   [2] = KEY_INSERT,    [3] = KEY_DELETE, [4] = KEY_END,
+    [5] = KEY_PAGE_UP, [6] = KEY_PAGE_DOWN, [7] = KEY_HOME,   [8] = KEY_END,
+    [11] = KEY_F1,    [12] = KEY_F2,       [13] = KEY_F3,    [14] = KEY_F4,
+    [15] = KEY_F5,    [17] = KEY_F6,       [18] = KEY_F7,    [19] = KEY_F8,
+    [20] = KEY_F9,    [21] = KEY_F10,      [23] = KEY_F11,   [24] = KEY_F12,
+};
+
+// Kitty keypad code points (57399 = KP_0 ... 57426 = KP_DELETE)
+#define KITTY_KEYPAD_FIRST 57399
+static const struct {
+  uint8_t code;
+  char ch;
+} kitty_keypad_keys[] = {
+    {KEY_CHAR, '0'},     {KEY_CHAR, '1'},      {KEY_CHAR, '2'},
+    {KEY_CHAR, '3'},     {KEY_CHAR, '4'},      {KEY_CHAR, '5'},
+    {KEY_CHAR, '6'},     {KEY_CHAR, '7'},      {KEY_CHAR, '8'},
+    {KEY_CHAR, '9'},     {KEY_CHAR, '.'},      {KEY_CHAR, '/'},
+    {KEY_CHAR, '*'},     {KEY_CHAR, '-'},      {KEY_CHAR, '+'},
+    {KEY_ENTER, 0},      {KEY_CHAR, '='},      {KEY_CHAR, ','},
+    {KEY_LEFT, 0},       {KEY_RIGHT, 0},       {KEY_UP, 0},
+    {KEY_DOWN, 0},       {KEY_PAGE_UP, 0},     {KEY_PAGE_DOWN, 0},
+    {KEY_HOME, 0},       {KEY_END, 0},         {KEY_INSERT, 0},
+    {KEY_DELETE, 0},
+};
+
+// Parse the body of a CSI sequence starting after ESC [
+// Returns bytes consumed (including ESC [), 0 if incomplete, or if malformed
+// minus the bytes to drop: through the final byte, or up to a control byte
+static int parse_csi(const char *buf, int len, CsiSeq *seq) {
+  memset(seq, 0, sizeof(*seq));
+
+  int i = 2;
+  if (i < len && buf[i] >= 0x3c && buf[i] <= 0x3f) {
+    seq->prefix = buf[i++];
+  }
+
+  int sub = 0;
+  int bad = 0;
+  for (; i < len; i++) {
+    unsigned char c = buf[i];
+    if (c < 0x20 || c > 0x7e) {
+      return -i; // Control byte or ESC inside the sequence
+    } else if (i >= CSI_MAX_LEN || bad) {
+      // Too long or malformed: skip to the final byte
+      bad = 1;
+      if (c >= 0x40)
+        return -(i + 1);
+    } else if (c >= '0' && c <= '9') {
+      if (seq->count == 0)
+        seq->count = 1;
+      if (seq->count <= CSI_MAX_PARAMS && sub < CSI_MAX_SUBPARAMS) {
+        uint32_t *p = &seq->params[seq->count - 1][sub];
+        if (*p < 100000000)
+          *p = *p * 10 + (c - '0');
+      }
+    } else if (c == ';') {
+      seq->count = (seq->count == 0 ? 1 : seq->count) + 1;
+      sub = 0;
+    } else if (c == ':') {
+      if (seq->count == 0)
+        seq->count = 1;
+      sub++;
+    } else if (c >= 0x20 && c <= 0x2f) {
+      seq->intermediate = c;
+    } else if (c >= 0x40 && c <= 0x7e) {
+      seq->final = c;
+      if (seq->count > CSI_MAX_PARAMS)
+        seq->count = CSI_MAX_PARAMS;
+      return i + 1;
+    } else {
+      bad = 1; // Private marker after the first byte
+    }
+  }
+  return 0;
+}
+
+// Decode an xterm/kitty modifier parameter (1 + bitmask)
+static uint8_t decode_mods(uint32_t param) {
+  if (param < 2)
+    return MOD_NONE;
+  uint32_t m = param - 1;
+  uint8_t mod = MOD_NONE;
+  if (m & 1)
+    mod |= MOD_SHIFT;
+  if (m & 2)
+    mod |= MOD_ALT;
+  if (m & 4)
+    mod |= MOD_CTRL;
+  if (m & 8)
+    mod |= MOD_SUPER;
+  return mod;
+}
+
+// Decode a kitty event type subparameter (1 = press, 2 = repeat, 3 = release)
+static uint8_t decode_action(uint32_t type) {
+  switch (type) {
+  case 2:
+    return KEY_ACTION_REPEAT;
+  case 3:
+    return KEY_ACTION_RELEASE;
+  default:
+    return KEY_ACTION_PRESS;
+  }
+}
+
+// Map a Unicode code point from kitty or modifyOtherKeys to a key
+static void key_from_codepoint(uint32_t cp, KeyEvent *key) {
+  switch (cp) {
+  case 13:
+    key->code = KEY_ENTER;
+    return;
+  case 9:
+    key->code = KEY_TAB;
+    return;
+  case 8:
+  case 127:
+    key->code = KEY_BACKSPACE;
+    return;
+  case 27:
+    key->code = KEY_ESCAPE;
+    return;
+  }
+
+  if (cp >= KITTY_KEYPAD_FIRST &&
+      cp < KITTY_KEYPAD_FIRST + sizeof(kitty_keypad_keys) /
+                                    sizeof(kitty_keypad_keys[0])) {
+    key->code = kitty_keypad_keys[cp - KITTY_KEYPAD_FIRST].code;
+    key->ch = kitty_keypad_keys[cp - KITTY_KEYPAD_FIRST].ch;
+    return;
+  }
+
+  if (cp >= 57344 && cp <= 63743) {
+    // Other kitty functional keys (F13+, media, lone modifiers)
+    key->code = KEY_UNKNOWN;
+    return;
+  }
+
+  key->code = KEY_CHAR;
+  key->codepoint = cp;
+  key->ch = cp < 128 ? (char)cp : 0;
+}
+
+// Translate a parsed CSI sequence into a key event
+static void csi_to_key(const CsiSeq *seq, KeyEvent *key) {
+  uint32_t p0 = seq->params[0][0];
+  key->mod = decode_mods(seq->params[1][0]);
+  key->action = decode_action(seq->params[1][1]);
+
+  if (seq->prefix || seq->intermediate) {
+    key->code = KEY_UNKNOWN; // Replies and private sequences
+    return;
+  }
+
+  switch (seq->final) {
+  case 'u': {
+    // Kitty: CSI code[:shifted[:base]] ; mods[:event] ; text u
+    uint32_t cp = p0;
+    if ((key->mod & MOD_SHIFT) && seq->params[0][1])
+      cp = seq->params[0][1];
+    if (seq->count >= 3 && seq->params[2][0])
+      cp = seq->params[2][0];
+    key_from_codepoint(cp, key);
+    if (key->code == KEY_CHAR && (key->mod & MOD_SHIFT) && cp >= 'a' &&
+        cp <= 'z') {
+      key->ch = cp - 'a' + 'A';
+      key->codepoint = key->ch;
+    }
+    return;
+  }
+
+  case '~':
+    if (p0 == 27) {
+      // modifyOtherKeys: CSI 27 ; mods ; code ~
+      key->mod = decode_mods(seq->params[1][0]);
+      key->action = KEY_ACTION_PRESS;
+      key_from_codepoint(seq->params[2][0], key);
+      return;
+    }
+    if (p0 < sizeof(tilde_keys) && tilde_keys[p0]) {
+      key->code = tilde_keys[p0];
+      return;
+    }
+    break;
+
+  default:
+    if (letter_keys[(unsigned char)seq->final]) {
+      key->code = letter_keys[(unsigned char)seq->final];
+      if (seq->final == 'Z')
+        key->mod |= MOD_SHIFT;
+      return;
+    }
+    break;
+  }
+
+  key->code = KEY_UNKNOWN;
+}
+
+static int parse_key(const char *buf, int len, int flush, KeyEvent *key);
 
 // Parse escape sequence into key event
+// flush: no more bytes will arrive, so resolve incomplete sequences
 // Returns number of bytes consumed, or 0 if incomplete
-static int parse_escape_seq(const char *buf, int len, KeyEvent *key) {
-  if (len < 2)
-    return 0;
+static int parse_escape_seq(const char *buf, int len, int flush,
+                            KeyEvent *key) {
+  if (len < 2) {
+    if (!flush)
+      return 0;
+    key->code = KEY_ESCAPE;
+    return 1;
+  }
 
   // ESC [ sequences (CSI)
   if (buf[1] == '[') {
-    if (len < 3)
+    CsiSeq seq;
+    int n = parse_csi(buf, len, &seq);
+    if (n > 0) {
+      csi_to_key(&seq, key);
+      return n;
+    }
+    if (n == 0 && !flush)
       return 0;
-
-    // Arrow keys and simple sequences
-    switch (buf[2]) {
-    case 'A':
-      key->code = KEY_UP;
-      return 3;
-    case 'B':
-      key->code = KEY_DOWN;
-      return 3;
-    case 'C':
-      key->code = KEY_RIGHT;
-      return 3;
-    case 'D':
-      key->code = KEY_LEFT;
-      return 3;
-    case 'H':
-      key->code = KEY_HOME;
-      return 3;
-    case 'F':
-      key->code = KEY_END;
-      return 3;
+    if (len == 2) {
+      // Alt+[
+      key->code = KEY_CHAR;
+      key->ch = '[';
+      key->mod = MOD_ALT;
+      return 2;
     }
+    // Malformed or truncated: drop the whole run rather than misreport keys
+    key->code = KEY_UNKNOWN;
+    return n < 0 ? -n : len;
+  }
 
-    // Extended sequences: ESC [ <num> ~
-    if (buf[2] >= '0' && buf[2] <= '9') {
-      if (len < 4)
+  // ESC O sequences (SS3)
+  if (buf[1] == 'O') {
+    if (len < 3) {
+      if (!flush)
         return 0;
-      if (buf[3] == '~') {
-        switch (buf[2]) {
-        case '1':
-          key->code = KEY_HOME;
-          return 4;
-        case '2':
-          key->code = KEY_INSERT;
-          return 4;
-        case '3':
-          key->code = KEY_DELETE;
-          return 4;
-        case '4':
-          key->code = KEY_END;
-          return 4;
-        case '5':
-          key->code = KEY_PAGE_UP;
-          return 4;
-        case '6':
-          key->code = KEY_PAGE_DOWN;
-          return 4;
-        case '7':
-          key->code = KEY_HOME;
-          return 4;
-        case '8':
-          key->code = KEY_END;
-          return 4;
-        }
-      }
-      // Function keys: ESC [ 1 <num> ~
-      if (buf[2] == '1' && len >= 5 && buf[4] == '~') {
-        switch (buf[3]) {
-        case '5':
-          key->code = KEY_F5;
-          return 5;
-        case '7':
-          key->code = KEY_F6;
-          return 5;
-        case '8':
-          key->code = KEY_F7;
-          return 5;
-        case '9':
-          key->code = KEY_F8;
-          return 5;
-        }
-      }
-      if (buf[2] == '2' && len >= 5 && buf[4] == '~') {
-        switch (buf[3]) {
-        case '0':
-          key->code = KEY_F9;
-          return 5;
-        case '1':
-          key->code = KEY_F10;
-          return 5;
-        case '3':
-          key->code = KEY_F11;
-          return 5;
-        case '4':
-          key->code = KEY_F12;
-          return 5;
-        }
-      }
+      key->code = KEY_CHAR;
+      key->ch = 'O';
+      key->mod = MOD_ALT;
+      return 2;
     }
+    unsigned char final = buf[2];
+    key->code = final < 128 && letter_keys[final] ? letter_keys[final]
+                                                  : KEY_UNKNOWN;
+    return 3;
   }
 
-  // ESC O sequences (SS3) - F1-F4
-  if (buf[1] == 'O') {
-    if (len < 3)
-      return 0;
-    switch (buf[2]) {
-    case 'P':
-      key->code = KEY_F1;
-      return 3;
-    case 'Q':
-      key->code = KEY_F2;
-      return 3;
-    case 'R':
-      key->code = KEY_F3;
-      return 3;
-    case 'S':
-      key->code = KEY_F4;
-      return 3;
-    }
+  // ESC ESC: the first one is a bare escape
+  if (buf[1] == 0x1b) {
+    key->code = KEY_ESCAPE;
+    return 1;
   }
 
-  // Unknown escape sequence - treat as bare ESC + Alt
-  key->code = KEY_CHAR;
-  key->ch = buf[1];
+  // ESC <key>: the key with Alt held
+  int n = parse_key(buf + 1, len - 1, flush, key);
+  if (n == 0)
+    return 0;
   key->mod |= MOD_ALT;
-  return 2;
+  return n + 1;
 }
 
 // Parse a single key from input buffer
-static int parse_key(const char *buf, int len, KeyEvent *key) {
+// Returns number of bytes consumed, or 0 if more input is needed
+static int parse_key(const char *buf, int len, int flush, KeyEvent *key) {
   memset(key, 0, sizeof(*key));
 
   if (len == 0)
@@ -164,12 +382,7 @@ static int parse_key(const char *buf, int len, KeyEvent *key) {
 
   // Escape sequence
   if (c == 0x1b) {
-    if (len == 1) {
-      // Bare escape
-      key->code = KEY_ESCAPE;
-      return 1;
-    }
-    return parse_escape_seq(buf, len, key);
+    return parse_escape_seq(buf, len, flush, key);
   }
 
   // Control characters
@@ -208,26 +421,48 @@ static int parse_key(const char *buf, int len, KeyEvent *key) {
   return 1;
 }
 
-int event_poll(Event *event, int timeout_ms) {
-  memset(event, 0, sizeof(*event));
+int event_watch_fd(int fd, void *userdata) {
+  if (fd < 0 || fd >= FD_SETSIZE)
+    return -1;
 
-  // Check for pending resize
-  if (resize_pending) {
-    resize_pending = 0;
-    event->type = EVENT_RESIZE;
-    tty_get_size(&event->resize.rows, &event->resize.cols);
-    return 1;
+  InputState *in = g_input;
+  for (int i = 0; i < in->watched_count; i++) {
+    if (in->watched[i].fd == fd) {
+      in->watched[i].userdata = userdata;
+      return 0;
+    }
   }
-
-  int fd = tty_get_fd();
-  if (fd < 0) {
+  if (in->watched_count >= EVENT_MAX_FDS)
     return -1;
+  in->watched[in->watched_count++] = (WatchedFd){fd, userdata, 0};
+  return 0;
+}
+
+void event_unwatch_fd(int fd) {
+  InputState *in = g_input;
+  for (int i = 0; i < in->watched_count; i++) {
+    if (in->watched[i].fd == fd) {
+      in->watched[i] = in->watched[--in->watched_count];
+      return;
+    }
   }
+}
 
-  // Set up select for input with timeout
+// Wait up to timeout_ms for the tty (fd, or -1 to skip it) or a watched fd
+// to become readable, and mark each watched fd found readable
+// Returns 1 if the tty is readable, 0 if not, -1 on error
+static int wait_input(int fd, int timeout_ms) {
+  InputState *in = g_input;
   fd_set fds;
   FD_ZERO(&fds);
-  FD_SET(fd, &fds);
+  int max_fd = fd;
+  if (fd >= 0)
+    FD_SET(fd, &fds);
+  for (int i = 0; i < in->watched_count; i++) {
+    FD_SET(in->watched[i].fd, &fds);
+    if (in->watched[i].fd > max_fd)
+      max_fd = in->watched[i].fd;
+  }
 
   struct timeval tv;
   struct timeval *tvp = NULL;
@@ -237,33 +472,514 @@ int event_poll(Event *event, int timeout_ms) {
     tvp = &tv;
   }
 
-  int ret = select(fd + 1, &fds, NULL, NULL, tvp);
+  int ret = select(max_fd + 1, &fds, NULL, NULL, tvp);
+  if (ret <= 0)
+    return ret;
 
-  // Check resize again (signal may have interrupted select)
-  if (resize_pending) {
-    resize_pending = 0;
-    event->type = EVENT_RESIZE;
-    tty_get_size(&event->resize.rows, &event->resize.cols);
+  for (int i = 0; i < in->watched_count; i++) {
+    if (FD_ISSET(in->watched[i].fd, &fds))
+      in->watched[i].ready = 1;
+  }
+  return fd >= 0 && FD_ISSET(fd, &fds);
+}
+
+// Wait up to timeout_ms for input and append it to the input buffer
+// Returns bytes read, 0 on timeout or if only watched fds are readable,
+// -1 on error or EOF
+static int read_input(int fd, int timeout_ms) {
+  InputState *in = g_input;
+  if (in->len >= INPUT_BUF_SIZE)
+    return 0;
+
+  int ret = wait_input(fd, timeout_ms);
+  if (ret <= 0)
+    return ret;
+
+  int len = read(fd, in->buf + in->len, INPUT_BUF_SIZE - in->len);
+  if (len <= 0)
+    return -1;
+  in->len += len;
+  return len;
+}
+
+// Input recording and replay
+// File format: "TTKR" <version> <rows> <cols>, then one record per raw read
+// or resize: <type> <delta_ms> followed by <len> <bytes> (input) or
+// <rows> <cols> (resize). Numbers are LEB128 varints.
+#define RECORD_MAGIC "TTKR"
+#define RECORD_VERSION 1
+
+enum { RECORD_INPUT = 0, RECORD_RESIZE = 1 };
+
+static FILE *record_file = NULL;
+static uint64_t record_last_ms;
+
+typedef struct {
+  FILE *file;
+  int realtime;     // Honor recorded timing instead of running at full speed
+  uint64_t now;     // Virtual clock (full speed mode)
+  int has_record;   // The fields below hold the next undelivered record
+  int type;
+  uint64_t time;    // Record time on the replay clock
+  int rows, cols;   // RECORD_RESIZE payload
+  char data[INPUT_BUF_SIZE]; // RECORD_INPUT payload
+  int len, off;
+  int resize_pending;
+  int resize_rows, resize_cols;
+} Replay;
+
+static Replay replay;
+
+static void write_varint(FILE *f, uint64_t v) {
+  while (v >= 0x80) {
+    fputc((int)(v & 0x7f) | 0x80, f);
+    v >>= 7;
+  }
+  fputc((int)v, f);
+}
+
+static int read_varint(FILE *f, uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = fgetc(f);
+    if (c == EOF)
+      return -1;
+    *v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return 0;
+  }
+  return -1;
+}
+
+static void record_header(int type) {
+  uint64_t now = timer_now_ms();
+  fputc(type, record_file);
+  write_varint(record_file, now - record_last_ms);
+  record_last_ms = now;
+}
+
+static void record_input(const char *bytes, int len) {
+  if (!record_file)
+    return;
+  record_header(RECORD_INPUT);
+  write_varint(record_file, len);
+  fwrite(bytes, 1, len, record_file);
+  fflush(record_file); // Keep the file usable if the app crashes
+}
+
+static void record_resize(int rows, int cols) {
+  if (!record_file)
+    return;
+  record_header(RECORD_RESIZE);
+  write_varint(record_file, rows);
+  write_varint(record_file, cols);
+  fflush(record_file);
+}
+
+int event_record_start(const char *path) {
+  event_record_stop();
+  record_file = fopen(path, "wb");
+  if (!record_file)
+    return -1;
+
+  int rows = 0, cols = 0;
+  tty_get_size(&rows, &cols);
+  fwrite(RECORD_MAGIC, 1, 4, record_file);
+  fputc(RECORD_VERSION, record_file);
+  write_varint(record_file, rows);
+  write_varint(record_file, cols);
+  fflush(record_file);
+  record_last_ms = timer_now_ms();
+  return 0;
+}
+
+void event_record_stop(void) {
+  if (record_file) {
+    fclose(record_file);
+    record_file = NULL;
+  }
+}
+
+static uint64_t replay_clock(void) { return replay.now; }
+
+static uint64_t replay_now(void) {
+  return replay.realtime ? timer_now_ms() : replay.now;
+}
+
+// Let time pass on the replay clock
+static void replay_sleep(uint64_t ms) {
+  if (!replay.realtime) {
+    replay.now += ms;
+    return;
+  }
+  struct timeval tv = {.tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000};
+  select(0, NULL, NULL, NULL, &tv);
+}
+
+// Load the next record if none is pending
+// Returns 1 if a record is pending, 0 at end of file
+static int replay_peek(void) {
+  if (replay.has_record)
     return 1;
+
+  int type = fgetc(replay.file);
+  uint64_t delta, a, b;
+  if (type == EOF || read_varint(replay.file, &delta) == -1 ||
+      read_varint(replay.file, &a) == -1)
+    return 0;
+
+  if (type == RECORD_INPUT) {
+    if (a == 0 || a > INPUT_BUF_SIZE ||
+        fread(replay.data, 1, a, replay.file) != a)
+      return 0;
+    replay.len = (int)a;
+    replay.off = 0;
+  } else if (type == RECORD_RESIZE) {
+    if (read_varint(replay.file, &b) == -1)
+      return 0;
+    replay.rows = (int)a;
+    replay.cols = (int)b;
+  } else {
+    return 0;
   }
 
-  if (ret == -1) {
+  replay.type = type;
+  replay.time += delta;
+  replay.has_record = 1;
+  return 1;
+}
+
+// Replay counterpart of read_input: deliver the next record once the replay
+// clock reaches it, waiting at most timeout_ms
+// Returns bytes delivered, 0 on timeout or resize, -1 at end of recording
+static int replay_input(int timeout_ms) {
+  if (!replay_peek())
     return -1;
+
+  uint64_t now = replay_now();
+  if (replay.time > now) {
+    uint64_t wait = replay.time - now;
+    if (timeout_ms >= 0 && wait > (uint64_t)timeout_ms) {
+      replay_sleep(timeout_ms);
+      return 0;
+    }
+    replay_sleep(wait);
   }
-  if (ret == 0) {
-    event->type = EVENT_NONE;
+
+  if (replay.type == RECORD_RESIZE) {
+    replay.resize_pending = 1;
+    replay.resize_rows = replay.rows;
+    replay.resize_cols = replay.cols;
+    replay.has_record = 0;
     return 0;
   }
 
-  // Read input
-  char buf[16];
-  int len = read(fd, buf, sizeof(buf));
-  if (len <= 0) {
+  int n = replay.len - replay.off;
+  if (n > INPUT_BUF_SIZE - g_input->len)
+    n = INPUT_BUF_SIZE - g_input->len;
+  memcpy(g_input->buf + g_input->len, replay.data + replay.off, n);
+  g_input->len += n;
+  replay.off += n;
+  if (replay.off == replay.len)
+    replay.has_record = 0;
+  return n;
+}
+
+int event_replay_start(const char *path, int realtime) {
+  event_replay_stop();
+
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return -1;
+
+  char magic[4];
+  uint64_t rows, cols;
+  if (fread(magic, 1, 4, f) != 4 || memcmp(magic, RECORD_MAGIC, 4) != 0 ||
+      fgetc(f) != RECORD_VERSION || read_varint(f, &rows) == -1 ||
+      read_varint(f, &cols) == -1) {
+    fclose(f);
     return -1;
   }
 
-  // Parse key
+  memset(&replay, 0, sizeof(replay));
+  replay.file = f;
+  replay.realtime = realtime;
+  replay.now = timer_now_ms();
+  replay.time = replay.now;
+  if (!realtime)
+    timer_set_clock(replay_clock);
+
+  // Start at the recorded terminal size
+  replay.resize_pending = 1;
+  replay.resize_rows = (int)rows;
+  replay.resize_cols = (int)cols;
+  return 0;
+}
+
+void event_replay_stop(void) {
+  if (replay.file) {
+    fclose(replay.file);
+    replay.file = NULL;
+    timer_set_clock(NULL);
+  }
+}
+
+// Read input from the tty (recording it) or from the replay file
+static int fill_input(int fd, int timeout_ms) {
+  if (replay.file) {
+    // Watched fds are live even then; they just don't hold up the replay
+    if (g_input->watched_count > 0)
+      wait_input(-1, 0);
+    return replay_input(timeout_ms);
+  }
+
+  int ret = read_input(fd, timeout_ms);
+  if (ret > 0)
+    record_input(g_input->buf + g_input->len - ret, ret);
+  return ret;
+}
+
+// Decode an SGR mouse report: CSI < Cb ; Cx ; Cy M (press) or m (release)
+static void csi_to_mouse(const CsiSeq *seq, MouseEvent *mouse) {
+  uint32_t cb = seq->params[0][0];
+
+  mouse->mod = MOD_NONE;
+  if (cb & 4)
+    mouse->mod |= MOD_SHIFT;
+  if (cb & 8)
+    mouse->mod |= MOD_ALT;
+  if (cb & 16)
+    mouse->mod |= MOD_CTRL;
+
+  if (cb & 64) {
+    mouse->button = MOUSE_WHEEL_UP + (cb & 3);
+    mouse->action = MOUSE_PRESS;
+  } else {
+    mouse->button = MOUSE_BUTTON_LEFT + (cb & 3);
+    if (cb & 32)
+      mouse->action = MOUSE_MOTION;
+    else
+      mouse->action = seq->final == 'm' ? MOUSE_RELEASE : MOUSE_PRESS;
+  }
+
+  mouse->count = 1;
+  mouse->col = seq->params[1][0] > 0 ? (int)seq->params[1][0] - 1 : 0;
+  mouse->row = seq->params[2][0] > 0 ? (int)seq->params[2][0] - 1 : 0;
+}
+
+// Parse a single event (key or mouse report) from input buffer
+// Returns number of bytes consumed, or 0 if more input is needed
+static int parse_event(const char *buf, int len, int flush, Event *event) {
+  if (len >= 3 && buf[0] == 0x1b && buf[1] == '[' && buf[2] == '<') {
+    CsiSeq seq;
+    int n = parse_csi(buf, len, &seq);
+    if (n == 0 && !flush)
+      return 0;
+    if (n > 0 && (seq.final == 'M' || seq.final == 'm')) {
+      event->type = EVENT_MOUSE;
+      csi_to_mouse(&seq, &event->mouse);
+      return n;
+    }
+  }
+
   event->type = EVENT_KEY;
-  parse_key(buf, len, &event->key);
+  return parse_key(buf, len, flush, &event->key);
+}
+
+// Consume the parsed event from the front of the input buffer
+static void consume_input(int n) {
+  g_input->len -= n;
+  memmove(g_input->buf, g_input->buf + n, g_input->len);
+}
+
+// Fold wheel notches and motion reports that are already waiting in the
+// input buffer into one event, so a wheel flick costs a single render
+static void coalesce_mouse(int fd, MouseEvent *mouse) {
+  int is_wheel = mouse->button >= MOUSE_WHEEL_UP;
+  if (!is_wheel && mouse->action != MOUSE_MOTION)
+    return;
+
+  for (;;) {
+    Event next;
+    int n = parse_event(g_input->buf, g_input->len, 0, &next);
+    if (n == 0) {
+      // Pull in whatever the terminal has already sent, without waiting
+      if (fill_input(fd, 0) <= 0)
+        return;
+      continue;
+    }
+    if (next.type != EVENT_MOUSE || next.mouse.button != mouse->button ||
+        next.mouse.action != mouse->action || next.mouse.mod != mouse->mod)
+      return;
+
+    if (mouse->count < UINT16_MAX)
+      mouse->count++;
+    mouse->row = next.mouse.row;
+    mouse->col = next.mouse.col;
+    consume_input(n);
+  }
+}
+
+// Parse the next buffered event, waiting briefly if a sequence is split
+static void next_event(int fd, Event *event) {
+  int n = parse_event(g_input->buf, g_input->len, 0, event);
+  while (n == 0) {
+    int flush = fill_input(fd, ESC_TIMEOUT_MS) <= 0;
+    n = parse_event(g_input->buf, g_input->len, flush, event);
+  }
+  consume_input(n);
+
+  if (event->type == EVENT_MOUSE)
+    coalesce_mouse(fd, &event->mouse);
+}
+
+// Live SIGWINCH or notified resize, or a resize read from the replay file
+static int resize_waiting(void) {
+  if (replay.file)
+    return replay.resize_pending;
+  return g_input->resize_pending ||
+         (g_input == &g_default_input && resize_pending);
+}
+
+void event_notify_resize(void) { g_input->resize_pending = 1; }
+
+static int resize_event(Event *event) {
+  event->type = EVENT_RESIZE;
+  tty_invalidate_screen(); // The terminal may have reflowed or cleared it
+  if (replay.file) {
+    replay.resize_pending = 0;
+    event->resize.rows = replay.resize_rows;
+    event->resize.cols = replay.resize_cols;
+    return 1;
+  }
+
+  g_input->resize_pending = 0;
+  if (g_input == &g_default_input)
+    resize_pending = 0;
+  tty_get_size(&event->resize.rows, &event->resize.cols);
+  record_resize(event->resize.rows, event->resize.cols);
+  return 1;
+}
+
+// Deliver the next expired timer, if any
+static int timer_event(Event *event) {
+  if (!timer_expire(&event->timer.id, &event->timer.userdata))
+    return 0;
+  event->type = EVENT_TIMER;
+  return 1;
+}
+
+// Deliver the first watched fd found readable by the last wait, if any
+static int fd_event(Event *event) {
+  InputState *in = g_input;
+  for (int i = 0; i < in->watched_count; i++) {
+    if (in->watched[i].ready) {
+      in->watched[i].ready = 0;
+      event->type = EVENT_FD;
+      event->fd.fd = in->watched[i].fd;
+      event->fd.userdata = in->watched[i].userdata;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Time to wait for input: the caller's timeout capped by the next timer
+static int wait_timeout(int timeout_ms, uint64_t deadline) {
+  int wait = -1;
+  if (timeout_ms >= 0) {
+    uint64_t now = timer_now_ms();
+    wait = deadline > now ? (int)(deadline - now) : 0;
+  }
+  int timer_wait = timer_next_timeout();
+  if (timer_wait >= 0 && (wait < 0 || timer_wait < wait))
+    wait = timer_wait;
+  return wait;
+}
+
+int event_poll(Event *event, int timeout_ms) {
+  memset(event, 0, sizeof(*event));
+
+  // Check for pending resize
+  if (resize_waiting()) {
+    return resize_event(event);
+  }
+
+  if (timer_event(event)) {
+    return 1;
+  }
+
+  int fd = tty_get_fd();
+  if (fd < 0 && !replay.file) {
+    return -1;
+  }
+
+  // Keys left over from a previous read are delivered without waiting,
+  // then fds that were readable alongside them
+  if (g_input->len == 0) {
+    if (fd_event(event)) {
+      return 1;
+    }
+
+    uint64_t deadline = timeout_ms >= 0 ? timer_now_ms() + timeout_ms : 0;
+    for (;;) {
+      int ret = fill_input(fd, wait_timeout(timeout_ms, deadline));
+
+      // Check resize again (signal may have interrupted select)
+      if (resize_waiting()) {
+        return resize_event(event);
+      }
+
+      if (ret == -1) {
+        return -1;
+      }
+      if (ret > 0) {
+        break;
+      }
+      if (fd_event(event)) {
+        return 1;
+      }
+
+      // Timed out: a timer is due, or the caller's timeout elapsed
+      if (timer_event(event)) {
+        return 1;
+      }
+      if (timeout_ms >= 0 && timer_now_ms() >= deadline) {
+        event->type = EVENT_NONE;
+        return 0;
+      }
+    }
+  }
+
+  next_event(fd, event);
   return 1;
 }
+
+// Whether one of the first count events reports fd
+static int fd_in_batch(const Event *events, size_t count, int fd) {
+  for (size_t i = 0; i < count; i++) {
+    if (events[i].type == EVENT_FD && events[i].fd.fd == fd)
+      return 1;
+  }
+  return 0;
+}
+
+int event_poll_batch(Event *out, size_t cap, int timeout_ms) {
+  if (cap == 0)
+    return 0;
+
+  int ret = event_poll(&out[0], timeout_ms);
+  if (ret <= 0)
+    return ret;
+
+  size_t count = 1;
+  while (count < cap && event_poll(&out[count], 0) > 0) {
+    // A watched fd stays readable until the app reads it, which it does
+    // after the batch: end the batch rather than report it twice
+    Event *event = &out[count];
+    if (event->type == EVENT_FD && fd_in_batch(out, count, event->fd.fd))
+      break;
+    count++;
+  }
+  return (int)count;
+}
@@ -1,4 +1,5 @@
 #include "layout.h"
+#include <string.h>
 
 Rect rect_from_size(uint16_t width, uint16_t height) {
   return (Rect){0, 0, width, height};
@@ -22,147 +23,283 @@ Rect rect_intersection(Rect a, Rect b) {
   return (Rect){x1, y1, x2 - x1, y2 - y1};
 }
 
-int layout_split(Rect area, Direction direction, const Constraint *constraints,
-                 size_t num_constraints, Rect *out_rects) {
-  if (num_constraints == 0) {
-    return 0;
+// Shrink base sizes by deficit when they do not fit the axis
+// Lower priorities give up space first; within the priority level that
+// absorbs the remainder, every constraint shrinks in proportion to its size.
+static void shrink_sizes(const Constraint *constraints, size_t num_constraints,
+                         Rect *slots, uint64_t deficit) {
+  // Space held per priority level
+  uint64_t level_total[256] = {0};
+  for (size_t i = 0; i < num_constraints; i++) {
+    level_total[constraints[i].priority] += slots[i].width;
   }
 
-  uint16_t total_size =
-      (direction == DIRECTION_HORIZONTAL) ? area.width : area.height;
+  // Find the level that absorbs the rest of the deficit
+  int cut = 0;
+  while (cut < 255 && level_total[cut] <= deficit) {
+    deficit -= level_total[cut];
+    cut++;
+  }
+  if (level_total[cut] < deficit) {
+    deficit = level_total[cut]; // Only when every level is exhausted
+  }
 
-  // Temporary array for computed sizes
-  uint16_t sizes[num_constraints];
-  int is_flexible[num_constraints]; // 1 if Min/Max/Fill
+  uint64_t cut_total = level_total[cut];
+  uint64_t shrunk = 0;
+  for (size_t i = 0; i < num_constraints; i++) {
+    uint8_t prio = constraints[i].priority;
+    if (prio < cut) {
+      slots[i].width = 0;
+    } else if (prio == cut && cut_total > 0) {
+      uint16_t share = (uint16_t)(slots[i].width * deficit / cut_total);
+      slots[i].width -= share;
+      shrunk += share;
+    }
+  }
+
+  // Rounding remainder: one more cell from each constraint, left to right
+  for (size_t i = 0; i < num_constraints && shrunk < deficit; i++) {
+    if (constraints[i].priority == cut && slots[i].width > 0) {
+      slots[i].width--;
+      shrunk++;
+    }
+  }
+}
 
-  // Phase 1: Calculate fixed sizes and mark flexible constraints
-  uint16_t fixed_total = 0;
-  uint16_t fill_weight_total = 0;
-  uint16_t min_total = 0;
+// Solve constraint sizes along one axis
+// Each size is stored in slots[i].width, so the caller's output rects double
+// as scratch and no per-call buffer is needed. Over-constrained splits are
+// compressed by priority instead of failing.
+// Returns 0 on success, -1 on error (invalid ratio)
+static int solve_sizes(uint16_t total_size, const Constraint *constraints,
+                       size_t num_constraints, Rect *slots) {
+  // Phase 1: Calculate base sizes (64-bit sums cannot wrap, even for
+  // 10^5 constraints of up to 65535 cells each)
+  uint64_t base_total = 0;
+  uint64_t fill_weight_total = 0;
+  size_t min_count = 0;
 
   for (size_t i = 0; i < num_constraints; i++) {
     const Constraint *c = &constraints[i];
-    sizes[i] = 0;
-    is_flexible[i] = 0;
+    uint32_t size = 0;
 
     switch (c->type) {
     case CONSTRAINT_LENGTH:
-      sizes[i] = c->value1;
-      fixed_total += sizes[i];
+      size = c->value1;
       break;
 
     case CONSTRAINT_PERCENT:
-      sizes[i] = (uint16_t)((uint32_t)total_size * c->value1 / 100);
-      fixed_total += sizes[i];
+      size = (uint32_t)total_size * c->value1 / 100;
       break;
 
     case CONSTRAINT_RATIO:
       if (c->value2 == 0) {
         return -1; // Division by zero
       }
-      sizes[i] = (uint16_t)((uint32_t)total_size * c->value1 / c->value2);
-      fixed_total += sizes[i];
+      size = (uint32_t)total_size * c->value1 / c->value2;
       break;
 
     case CONSTRAINT_MIN:
-      sizes[i] = c->value1; // Start with minimum
-      min_total += c->value1;
-      is_flexible[i] = 1;
+      size = c->value1; // Start with minimum
+      min_count++;
       break;
 
     case CONSTRAINT_MAX:
-      sizes[i] = 0; // Start with 0, will fill up to max
-      is_flexible[i] = 1;
-      break;
+      break; // Start with 0, will fill up to max
 
     case CONSTRAINT_FILL:
-      sizes[i] = 0;
       fill_weight_total += c->value1;
-      is_flexible[i] = 1;
       break;
     }
+
+    // No single constraint can be larger than the axis
+    slots[i].width = (uint16_t)(size < total_size ? size : total_size);
+    base_total += slots[i].width;
   }
 
-  // Phase 2: Check for overflow
-  if (fixed_total + min_total > total_size) {
-    return -1; // Overflow
+  // Phase 2: Compress gracefully on overflow
+  if (base_total > total_size) {
+    shrink_sizes(constraints, num_constraints, slots, base_total - total_size);
+    return 0;
   }
 
   // Phase 3: Distribute remaining space to flexible constraints
-  uint16_t remaining = total_size - fixed_total - min_total;
+  uint32_t remaining = total_size - (uint32_t)base_total;
 
   // First pass: Fill up MAX constraints
   for (size_t i = 0; i < num_constraints && remaining > 0; i++) {
     if (constraints[i].type == CONSTRAINT_MAX) {
-      uint16_t can_take = constraints[i].value1;
+      uint32_t can_take = constraints[i].value1;
       if (can_take > remaining) {
         can_take = remaining;
       }
-      sizes[i] = can_take;
+      slots[i].width = (uint16_t)can_take;
       remaining -= can_take;
     }
   }
 
   // Second pass: Distribute to FILL constraints by weight
   if (fill_weight_total > 0 && remaining > 0) {
-    uint16_t fill_remaining = remaining;
+    uint32_t fill_remaining = remaining;
+    size_t last_fill = 0;
     for (size_t i = 0; i < num_constraints; i++) {
       if (constraints[i].type == CONSTRAINT_FILL) {
-        uint16_t share = (uint16_t)((uint32_t)fill_remaining *
+        uint32_t share = (uint32_t)((uint64_t)fill_remaining *
                                     constraints[i].value1 / fill_weight_total);
-        sizes[i] = share;
+        slots[i].width = (uint16_t)share;
         remaining -= share;
+        last_fill = i;
       }
     }
     // Give any rounding remainder to the last FILL
-    for (size_t i = num_constraints; i > 0 && remaining > 0; i--) {
-      if (constraints[i - 1].type == CONSTRAINT_FILL) {
-        sizes[i - 1] += remaining;
-        remaining = 0;
-        break;
-      }
-    }
+    slots[last_fill].width += (uint16_t)remaining;
+    remaining = 0;
   }
 
   // Third pass: Give remaining to MIN constraints (proportionally)
-  if (remaining > 0) {
-    size_t min_count = 0;
+  if (remaining > 0 && min_count > 0) {
+    uint32_t extra_each = remaining / min_count;
+    uint32_t extra_remainder = remaining % min_count;
     for (size_t i = 0; i < num_constraints; i++) {
       if (constraints[i].type == CONSTRAINT_MIN) {
-        min_count++;
-      }
-    }
-    if (min_count > 0) {
-      uint16_t extra_each = remaining / min_count;
-      uint16_t extra_remainder = remaining % min_count;
-      for (size_t i = 0; i < num_constraints; i++) {
-        if (constraints[i].type == CONSTRAINT_MIN) {
-          sizes[i] += extra_each;
-          if (extra_remainder > 0) {
-            sizes[i]++;
-            extra_remainder--;
-          }
+        slots[i].width += (uint16_t)extra_each;
+        if (extra_remainder > 0) {
+          slots[i].width++;
+          extra_remainder--;
         }
       }
     }
   }
 
-  // Phase 4: Build output Rects
+  return 0;
+}
+
+// Turn solved sizes (in each rect's width) into positioned Rects, in place
+static void build_rects(Rect area, Direction direction, size_t num_constraints,
+                        Rect *out_rects) {
   uint16_t pos = 0;
   for (size_t i = 0; i < num_constraints; i++) {
+    uint16_t size = out_rects[i].width;
     if (direction == DIRECTION_HORIZONTAL) {
       out_rects[i].x = area.x + pos;
       out_rects[i].y = area.y;
-      out_rects[i].width = sizes[i];
+      out_rects[i].width = size;
       out_rects[i].height = area.height;
     } else {
       out_rects[i].x = area.x;
       out_rects[i].y = area.y + pos;
       out_rects[i].width = area.width;
-      out_rects[i].height = sizes[i];
+      out_rects[i].height = size;
     }
-    pos += sizes[i];
+    pos += size;
+  }
+}
+
+int layout_split(Rect area, Direction direction, const Constraint *constraints,
+                 size_t num_constraints, Rect *out_rects) {
+  if (num_constraints == 0) {
+    return 0;
   }
 
+  uint16_t total_size =
+      (direction == DIRECTION_HORIZONTAL) ? area.width : area.height;
+
+  if (solve_sizes(total_size, constraints, num_constraints, out_rects) < 0) {
+    return -1;
+  }
+
+  build_rects(area, direction, num_constraints, out_rects);
+  return 0;
+}
+
+// Cross-frame split cache
+// Direct-mapped by a hash of the solver inputs (axis size and constraints).
+// Position and direction only affect rect building, so a panel that moves
+// without resizing still hits. Constraints are compared in full on lookup.
+#define LAYOUT_CACHE_SLOTS 256
+#define LAYOUT_CACHE_MAX_CONSTRAINTS 16 // Larger splits bypass the cache
+
+typedef struct {
+  uint32_t generation; // Valid only when equal to g_cache_generation
+  uint32_t hash;
+  uint16_t total_size;
+  uint16_t count;
+  Constraint constraints[LAYOUT_CACHE_MAX_CONSTRAINTS];
+  uint16_t sizes[LAYOUT_CACHE_MAX_CONSTRAINTS];
+} LayoutCacheEntry;
+
+static LayoutCacheEntry g_cache[LAYOUT_CACHE_SLOTS];
+static uint32_t g_cache_generation = 1;
+
+static uint32_t hash_constraints(uint16_t total_size,
+                                 const Constraint *constraints, size_t n) {
+  // FNV-1a over the fields (not the struct bytes, which may have padding)
+  uint32_t h = 2166136261u;
+  h = (h ^ total_size) * 16777619u;
+  h = (h ^ (uint32_t)n) * 16777619u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ (uint32_t)constraints[i].type) * 16777619u;
+    h = (h ^ constraints[i].value1) * 16777619u;
+    h = (h ^ constraints[i].value2) * 16777619u;
+    h = (h ^ constraints[i].priority) * 16777619u;
+  }
+  return h;
+}
+
+static int constraints_equal(const Constraint *a, const Constraint *b,
+                             size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (a[i].type != b[i].type || a[i].value1 != b[i].value1 ||
+        a[i].value2 != b[i].value2 || a[i].priority != b[i].priority)
+      return 0;
+  }
+  return 1;
+}
+
+int layout_split_cached(Rect area, Direction direction,
+                        const Constraint *constraints, size_t num_constraints,
+                        Rect *out_rects) {
+  if (num_constraints == 0 || num_constraints > LAYOUT_CACHE_MAX_CONSTRAINTS) {
+    return layout_split(area, direction, constraints, num_constraints,
+                        out_rects);
+  }
+
+  uint16_t total_size =
+      (direction == DIRECTION_HORIZONTAL) ? area.width : area.height;
+  uint32_t hash = hash_constraints(total_size, constraints, num_constraints);
+  LayoutCacheEntry *e = &g_cache[hash % LAYOUT_CACHE_SLOTS];
+
+  if (e->generation != g_cache_generation || e->hash != hash ||
+      e->total_size != total_size || e->count != num_constraints ||
+      !constraints_equal(e->constraints, constraints, num_constraints)) {
+    // Miss: solve and replace the slot
+    e->generation = 0;
+    if (solve_sizes(total_size, constraints, num_constraints, out_rects) < 0) {
+      return -1;
+    }
+    for (size_t i = 0; i < num_constraints; i++) {
+      e->sizes[i] = out_rects[i].width;
+    }
+    memcpy(e->constraints, constraints, sizeof(Constraint) * num_constraints);
+    e->hash = hash;
+    e->total_size = total_size;
+    e->count = (uint16_t)num_constraints;
+    e->generation = g_cache_generation;
+  } else {
+    for (size_t i = 0; i < num_constraints; i++) {
+      out_rects[i].width = e->sizes[i];
+    }
+  }
+
+  build_rects(area, direction, num_constraints, out_rects);
   return 0;
 }
+
+void layout_cache_invalidate(void) {
+  g_cache_generation++;
+  if (g_cache_generation == 0) {
+    // Wrapped: old entries could look valid again
+    memset(g_cache, 0, sizeof(g_cache));
+    g_cache_generation = 1;
+  }
+}
@@ -0,0 +1,182 @@
+#include "pool.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Worker k's share of a run is tasks k, k + threads, k + 2 * threads, ...
+// and [front, back) are the positions in that sequence still queued
+typedef struct {
+  struct TaskPool *pool;
+  size_t index;
+  pthread_mutex_t lock; // Guards front and back
+  size_t front;
+  size_t back;
+} Worker;
+
+struct TaskPool {
+  size_t threads;
+  Worker *workers;    // One per thread; workers[0] is the caller's
+  pthread_t *helpers; // threads - 1
+  size_t started;     // Helpers running
+
+  pthread_mutex_t lock; // Guards the fields below
+  pthread_cond_t start; // Signalled when a run begins or the pool stops
+  pthread_cond_t done;  // Signalled when the last helper finishes a run
+  uint64_t generation;  // Runs so far
+  size_t busy;          // Helpers not finished with this run
+  int stopping;
+  TaskFn fn;
+  void *ctx;
+};
+
+// Next task from the worker's own queue, front first
+static int take_task(Worker *w, size_t *task) {
+  int found = 0;
+  pthread_mutex_lock(&w->lock);
+  if (w->front < w->back) {
+    *task = w->index + w->front++ * w->pool->threads;
+    found = 1;
+  }
+  pthread_mutex_unlock(&w->lock);
+  return found;
+}
+
+// Last task of the first other queue that has one
+static int steal_task(TaskPool *pool, size_t thief, size_t *task) {
+  for (size_t k = 1; k < pool->threads; k++) {
+    Worker *victim = &pool->workers[(thief + k) % pool->threads];
+    int found = 0;
+    pthread_mutex_lock(&victim->lock);
+    if (victim->front < victim->back) {
+      *task = victim->index + --victim->back * pool->threads;
+      found = 1;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if (found)
+      return 1;
+  }
+  return 0;
+}
+
+// Run tasks until every queue is empty (no task is queued mid-run, so a
+// queue found empty stays empty)
+static void work(TaskPool *pool, size_t index) {
+  size_t task;
+  while (take_task(&pool->workers[index], &task) ||
+         steal_task(pool, index, &task)) {
+    pool->fn(pool->ctx, task, index);
+  }
+}
+
+static void *helper_main(void *arg) {
+  Worker *w = arg;
+  TaskPool *pool = w->pool;
+  uint64_t seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->stopping && pool->generation == seen)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if (pool->stopping)
+      break;
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, w->index);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->busy == 0)
+      pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+TaskPool *task_pool_create(size_t threads) {
+  if (threads < 2)
+    return NULL;
+
+  TaskPool *pool = calloc(1, sizeof(TaskPool));
+  if (!pool)
+    return NULL;
+  pool->threads = threads;
+  pool->workers = calloc(threads, sizeof(Worker));
+  pool->helpers = calloc(threads - 1, sizeof(pthread_t));
+  if (!pool->workers || !pool->helpers) {
+    free(pool->workers);
+    free(pool->helpers);
+    free(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  for (size_t k = 0; k < threads; k++) {
+    pool->workers[k].pool = pool;
+    pool->workers[k].index = k;
+    pthread_mutex_init(&pool->workers[k].lock, NULL);
+  }
+
+  for (size_t k = 1; k < threads; k++) {
+    if (pthread_create(&pool->helpers[k - 1], NULL, helper_main,
+                       &pool->workers[k]) != 0) {
+      task_pool_destroy(pool);
+      return NULL;
+    }
+    pool->started++;
+  }
+  return pool;
+}
+
+void task_pool_destroy(TaskPool *pool) {
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t k = 0; k < pool->started; k++) {
+    pthread_join(pool->helpers[k], NULL);
+  }
+
+  for (size_t k = 0; k < pool->threads; k++) {
+    pthread_mutex_destroy(&pool->workers[k].lock);
+  }
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool->helpers);
+  free(pool);
+}
+
+size_t task_pool_threads(const TaskPool *pool) { return pool->threads; }
+
+void task_pool_run(TaskPool *pool, TaskFn fn, void *ctx, size_t count) {
+  if (count == 0)
+    return;
+
+  // Helpers read the queues only after taking the pool lock below
+  for (size_t k = 0; k < pool->threads; k++) {
+    Worker *w = &pool->workers[k];
+    w->front = 0;
+    w->back = k < count ? (count - k + pool->threads - 1) / pool->threads : 0;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->ctx = ctx;
+  pool->busy = pool->threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  work(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->busy > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,26 @@
+#ifndef TTYKIT_POOL_H
+#define TTYKIT_POOL_H
+
+#include <stddef.h>
+
+// Work-stealing thread pool for short bursts of independent tasks (internal)
+// The calling thread works alongside threads - 1 helper threads. A run
+// deals its tasks round-robin to per-worker queues; each worker drains its
+// own queue front to back, then steals from the back of the others'.
+typedef struct TaskPool TaskPool;
+
+// Run one task; worker is 0 on the calling thread, else 1..threads - 1
+typedef void (*TaskFn)(void *ctx, size_t task, size_t worker);
+
+// Returns NULL if threads < 2 or the helpers could not be started
+TaskPool *task_pool_create(size_t threads);
+void task_pool_destroy(TaskPool *pool);
+
+// Workers in the pool, counting the calling thread
+size_t task_pool_threads(const TaskPool *pool);
+
+// Run tasks 0..count - 1 and return once all of them have finished
+// Tasks are dealt in index order, so list the costliest first.
+void task_pool_run(TaskPool *pool, TaskFn fn, void *ctx, size_t count);
+
+#endif // TTYKIT_POOL_H
@@ -0,0 +1,217 @@
+#include "ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Lines are placed at ever-growing byte positions; position % capacity is
+// the arena offset. A line that would cross the end of the arena starts
+// at the next lap instead, so a held line is always one contiguous span,
+// and a line is evicted once the newest line's end is a full arena past
+// its start. An unterminated tail is written in place at head as it
+// arrives, but only becomes a line once its newline does.
+typedef struct {
+  uint64_t start; // Byte position of the first character
+  size_t length;
+} LogLine;
+
+struct LogRing {
+  char *bytes;
+  size_t byte_capacity;
+  LogLine *lines; // Line number % line_capacity
+  size_t line_capacity;
+  uint64_t first; // Number of the oldest held line
+  uint64_t total; // Lines appended so far
+  uint64_t head;  // Byte position the next line starts at
+  size_t pending; // Bytes of the unterminated line at head
+};
+
+LogRing *log_ring_create(size_t max_lines, size_t max_bytes) {
+  if (max_lines == 0 || max_bytes == 0)
+    return NULL;
+
+  LogRing *ring = malloc(sizeof(LogRing));
+  if (!ring)
+    return NULL;
+
+  ring->bytes = malloc(max_bytes);
+  ring->lines = malloc(sizeof(LogLine) * max_lines);
+  if (!ring->bytes || !ring->lines) {
+    free(ring->bytes);
+    free(ring->lines);
+    free(ring);
+    return NULL;
+  }
+
+  ring->byte_capacity = max_bytes;
+  ring->line_capacity = max_lines;
+  ring->first = 0;
+  ring->total = 0;
+  ring->head = 0;
+  ring->pending = 0;
+  return ring;
+}
+
+void log_ring_destroy(LogRing *ring) {
+  if (ring) {
+    free(ring->bytes);
+    free(ring->lines);
+    free(ring);
+  }
+}
+
+// Evict the lines a span ending at byte position end would overwrite, and
+// the oldest line if take_slot is set and every slot is taken
+static void evict(LogRing *ring, uint64_t end, int take_slot) {
+  while (ring->first < ring->total) {
+    const LogLine *old = &ring->lines[ring->first % ring->line_capacity];
+    int slots_full = ring->total - ring->first >= ring->line_capacity;
+    if (!(take_slot && slots_full) && old->start + ring->byte_capacity >= end)
+      break;
+    ring->first++;
+  }
+}
+
+// Add text (no newline) to the pending line
+// A pending line longer than the arena is cut to fit.
+static void extend_pending(LogRing *ring, const char *text, size_t len) {
+  size_t cap = ring->byte_capacity;
+  if (len > cap - ring->pending)
+    len = cap - ring->pending;
+  if (len == 0)
+    return;
+
+  size_t offset = ring->head % cap;
+  if (ring->pending + len > cap - offset) {
+    // Restart the line at the next lap, carrying what it has so far
+    ring->head += cap - offset;
+    evict(ring, ring->head + ring->pending + len, 0);
+    memmove(ring->bytes, ring->bytes + offset, ring->pending);
+    offset = 0;
+  } else {
+    evict(ring, ring->head + ring->pending + len, 0);
+  }
+  memcpy(ring->bytes + offset + ring->pending, text, len);
+  ring->pending += len;
+}
+
+// Turn the pending line into the newest line
+static void commit_pending(LogRing *ring) {
+  evict(ring, ring->head + ring->pending, 1);
+  LogLine *line = &ring->lines[ring->total % ring->line_capacity];
+  line->start = ring->head;
+  line->length = ring->pending;
+  ring->total++;
+  ring->head += ring->pending;
+  ring->pending = 0;
+}
+
+void log_ring_append(LogRing *ring, const char *text, size_t len) {
+  const char *end = text + len;
+  while (text < end) {
+    const char *nl = memchr(text, '\n', end - text);
+    extend_pending(ring, text, (nl ? nl : end) - text);
+    if (!nl)
+      break;
+    commit_pending(ring);
+    text = nl + 1;
+  }
+}
+
+void log_ring_flush(LogRing *ring) {
+  if (ring->pending > 0)
+    commit_pending(ring);
+}
+
+size_t log_ring_count(const LogRing *ring) {
+  return ring->total - ring->first;
+}
+
+uint64_t log_ring_total(const LogRing *ring) { return ring->total; }
+
+const char *log_ring_line(const LogRing *ring, uint64_t number, size_t *len) {
+  if (number < ring->first || number >= ring->total)
+    return NULL;
+
+  const LogLine *line = &ring->lines[number % ring->line_capacity];
+  *len = line->length;
+  return ring->bytes + line->start % ring->byte_capacity;
+}
+
+struct TimeSeries {
+  double *values; // Sample number % capacity
+  size_t capacity;
+  size_t count;
+  uint64_t total;
+};
+
+TimeSeries *time_series_create(size_t capacity) {
+  if (capacity == 0)
+    return NULL;
+
+  TimeSeries *series = malloc(sizeof(TimeSeries));
+  if (!series)
+    return NULL;
+
+  series->values = malloc(sizeof(double) * capacity);
+  if (!series->values) {
+    free(series);
+    return NULL;
+  }
+
+  series->capacity = capacity;
+  series->count = 0;
+  series->total = 0;
+  return series;
+}
+
+void time_series_destroy(TimeSeries *series) {
+  if (series) {
+    free(series->values);
+    free(series);
+  }
+}
+
+void time_series_push(TimeSeries *series, double value) {
+  series->values[series->total % series->capacity] = value;
+  series->total++;
+  if (series->count < series->capacity)
+    series->count++;
+}
+
+size_t time_series_count(const TimeSeries *series) { return series->count; }
+
+uint64_t time_series_total(const TimeSeries *series) { return series->total; }
+
+double time_series_at(const TimeSeries *series, size_t index) {
+  uint64_t number = series->total - series->count + index;
+  return series->values[number % series->capacity];
+}
+
+int time_series_range(const TimeSeries *series, size_t first, size_t count,
+                      double *min, double *max) {
+  if (count == 0 || first >= series->count || count > series->count - first)
+    return -1;
+
+  // Scan the range as at most two contiguous runs of the ring
+  size_t start = (series->total - series->count + first) % series->capacity;
+  size_t run = series->capacity - start < count ? series->capacity - start
+                                                : count;
+  const double *v = series->values + start;
+  double lo = v[0], hi = v[0];
+  for (size_t i = 1; i < run; i++) {
+    if (v[i] < lo)
+      lo = v[i];
+    if (v[i] > hi)
+      hi = v[i];
+  }
+  v = series->values;
+  for (size_t i = 0; i < count - run; i++) {
+    if (v[i] < lo)
+      lo = v[i];
+    if (v[i] > hi)
+      hi = v[i];
+  }
+
+  *min = lo;
+  *max = hi;
+  return 0;
+}
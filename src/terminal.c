@@ -1,32 +1,90 @@
+#include "context.h"
 #include "ttykit.h"
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 
-static struct termios orig_termios;
-static int raw_mode_enabled = 0;
-static int tty_fd = -1;
+struct TtyState {
+  struct termios orig_termios;
+  int raw_mode_enabled;
+  int tty_fd;  // Input (and size queries); -1 until raw mode opens one
+  int out_fd;  // Output
+  int owns_fd; // tty_fd was opened here (the default context's /dev/tty)
+  Buffer *screen;   // Cells on screen after the last buffer_render
+  int screen_valid; // 0 if the screen may differ from screen
+};
+
+static TtyState g_default_tty = {.tty_fd = -1,
+                                 .out_fd = STDOUT_FILENO,
+                                 .owns_fd = 1};
+static TtyState *g_tty = &g_default_tty;
+
+TtyState *tty_state_create(int in_fd, int out_fd) {
+  TtyState *state = calloc(1, sizeof(TtyState));
+  if (!state)
+    return NULL;
+  state->tty_fd = in_fd;
+  state->out_fd = out_fd;
+  return state;
+}
+
+void tty_state_destroy(TtyState *state) {
+  if (!state)
+    return;
+  if (state->raw_mode_enabled)
+    tcsetattr(state->tty_fd, TCSAFLUSH, &state->orig_termios);
+  buffer_destroy(state->screen);
+  if (g_tty == state)
+    g_tty = &g_default_tty;
+  free(state);
+}
 
-int tty_get_fd(void) { return tty_fd; }
+void tty_state_bind(TtyState *state) {
+  g_tty = state ? state : &g_default_tty;
+}
+
+int tty_get_fd(void) { return g_tty->tty_fd; }
+
+Buffer *tty_screen_frame(int rows, int cols, int *valid) {
+  TtyState *t = g_tty;
+  Buffer *screen = t->screen;
+  if (screen && (screen->rows != rows || screen->cols != cols)) {
+    buffer_destroy(screen);
+    screen = t->screen = NULL;
+  }
+  *valid = screen && t->screen_valid;
+  if (!screen)
+    screen = t->screen = buffer_create(rows, cols);
+  t->screen_valid = screen != NULL;
+  return screen;
+}
+
+void tty_invalidate_screen(void) { g_tty->screen_valid = 0; }
 
 int tty_enable_raw_mode(void) {
-  if (raw_mode_enabled)
+  TtyState *t = g_tty;
+  if (t->raw_mode_enabled)
     return 0;
 
   // Open /dev/tty directly to handle piped stdin
-  tty_fd = open("/dev/tty", O_RDWR);
-  if (tty_fd == -1)
-    return -1;
+  if (t->owns_fd) {
+    t->tty_fd = open("/dev/tty", O_RDWR);
+    if (t->tty_fd == -1)
+      return -1;
+  }
 
-  if (tcgetattr(tty_fd, &orig_termios) == -1) {
-    close(tty_fd);
-    tty_fd = -1;
+  if (tcgetattr(t->tty_fd, &t->orig_termios) == -1) {
+    if (t->owns_fd) {
+      close(t->tty_fd);
+      t->tty_fd = -1;
+    }
     return -1;
   }
 
-  struct termios raw = orig_termios;
+  struct termios raw = t->orig_termios;
 
   // Input: no break, no CR to NL, no parity check, no strip, no flow ctrl
   raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
@@ -44,50 +102,66 @@ int tty_enable_raw_mode(void) {
   raw.c_cc[VMIN] = 1;
   raw.c_cc[VTIME] = 0;
 
-  if (tcsetattr(tty_fd, TCSAFLUSH, &raw) == -1) {
-    close(tty_fd);
-    tty_fd = -1;
+  if (tcsetattr(t->tty_fd, TCSAFLUSH, &raw) == -1) {
+    if (t->owns_fd) {
+      close(t->tty_fd);
+      t->tty_fd = -1;
+    }
     return -1;
   }
 
-  raw_mode_enabled = 1;
+  t->raw_mode_enabled = 1;
   return 0;
 }
 
 void tty_disable_raw_mode(void) {
-  if (raw_mode_enabled) {
-    tcsetattr(tty_fd, TCSAFLUSH, &orig_termios);
-    close(tty_fd);
-    tty_fd = -1;
-    raw_mode_enabled = 0;
+  TtyState *t = g_tty;
+  if (t->raw_mode_enabled) {
+    tcsetattr(t->tty_fd, TCSAFLUSH, &t->orig_termios);
+    if (t->owns_fd) {
+      close(t->tty_fd);
+      t->tty_fd = -1;
+    }
+    t->raw_mode_enabled = 0;
   }
 }
 
+void tty_write(const char *data, size_t len) {
+  write(g_tty->out_fd, data, len);
+}
+
 void tty_enter_alternate_screen(void) {
-  write(STDOUT_FILENO, "\x1b[?1049h", 8);
+  tty_write("\x1b[?1049h", 8);
+  tty_invalidate_screen();
 }
 
 void tty_leave_alternate_screen(void) {
-  write(STDOUT_FILENO, "\x1b[?1049l", 8);
+  tty_write("\x1b[?1049l", 8);
+  tty_invalidate_screen();
 }
 
-void tty_cursor_hide(void) { write(STDOUT_FILENO, "\x1b[?25l", 6); }
+void tty_cursor_hide(void) { tty_write("\x1b[?25l", 6); }
 
-void tty_cursor_show(void) { write(STDOUT_FILENO, "\x1b[?25h", 6); }
+void tty_cursor_show(void) { tty_write("\x1b[?25h", 6); }
 
 void tty_cursor_move(int row, int col) {
   char buf[32];
   int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", row, col);
-  write(STDOUT_FILENO, buf, len);
+  tty_write(buf, len);
 }
 
-void tty_cursor_home(void) { write(STDOUT_FILENO, "\x1b[H", 3); }
+void tty_cursor_home(void) { tty_write("\x1b[H", 3); }
 
-void tty_clear_screen(void) { write(STDOUT_FILENO, "\x1b[2J", 4); }
+void tty_clear_screen(void) {
+  tty_write("\x1b[2J", 4);
+  tty_invalidate_screen();
+}
 
 int tty_get_size(int *rows, int *cols) {
   struct winsize ws;
-  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1)
+  // Fall back to the tty when stdout is redirected (e.g. captured output)
+  if (ioctl(g_tty->out_fd, TIOCGWINSZ, &ws) == -1 &&
+      (g_tty->tty_fd < 0 || ioctl(g_tty->tty_fd, TIOCGWINSZ, &ws) == -1))
     return -1;
   if (rows)
     *rows = ws.ws_row;
@@ -95,3 +169,33 @@ int tty_get_size(int *rows, int *cols) {
     *cols = ws.ws_col;
   return 0;
 }
+
+void tty_enable_kitty_keyboard(int flags) {
+  char buf[16];
+  int len = snprintf(buf, sizeof(buf), "\x1b[>%du", flags);
+  tty_write(buf, len);
+}
+
+void tty_disable_kitty_keyboard(void) { tty_write("\x1b[<u", 4); }
+
+void tty_enable_modify_other_keys(void) {
+  tty_write("\x1b[>4;2m", 7);
+}
+
+void tty_disable_modify_other_keys(void) {
+  tty_write("\x1b[>4;0m", 7);
+}
+
+void tty_enable_mouse(MouseMode mode) {
+  tty_write("\x1b[?1000h", 8);
+  if (mode == MOUSE_MODE_DRAG) {
+    tty_write("\x1b[?1002h", 8);
+  } else if (mode == MOUSE_MODE_MOTION) {
+    tty_write("\x1b[?1003h", 8);
+  }
+  tty_write("\x1b[?1006h", 8);
+}
+
+void tty_disable_mouse(void) {
+  tty_write("\x1b[?1006l\x1b[?1003l\x1b[?1002l\x1b[?1000l", 32);
+}
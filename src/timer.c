@@ -0,0 +1,337 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime under -std=c99
+
+#include "timer.h"
+#include <stdlib.h>
+#include <time.h>
+
+// Hierarchical timer wheel with 1 ms ticks
+// Level 0 has one slot per tick for the next 256 ms; each higher level
+// covers 64 slots of the level below and is cascaded down when level 0
+// wraps. Arm and cancel are O(1) list operations.
+#define LEVEL0_BITS 8
+#define LEVELN_BITS 6
+#define WHEEL_LEVELS 4
+#define LEVEL0_SIZE (1 << LEVEL0_BITS)
+#define LEVELN_SIZE (1 << LEVELN_BITS)
+#define LEVEL0_MASK (LEVEL0_SIZE - 1)
+#define LEVELN_MASK (LEVELN_SIZE - 1)
+#define WHEEL_RANGE                                                            \
+  ((uint64_t)1 << (LEVEL0_BITS + (WHEEL_LEVELS - 1) * LEVELN_BITS))
+
+// Slot lists: wheel slots, then the expired FIFO
+#define WHEEL_SLOTS (LEVEL0_SIZE + (WHEEL_LEVELS - 1) * LEVELN_SIZE)
+#define EXPIRED_SLOT WHEEL_SLOTS
+#define NUM_LISTS (WHEEL_SLOTS + 1)
+#define SLOT_NONE 0xffff
+
+// Timer ids pack (generation << INDEX_BITS) | (index + 1)
+#define INDEX_BITS 20
+#define INDEX_MASK ((1u << INDEX_BITS) - 1)
+#define MAX_TIMERS (INDEX_MASK - 1)
+#define NIL UINT32_MAX
+
+typedef struct {
+  uint64_t expires;
+  uint32_t interval;
+  TimerCallback cb;
+  void *userdata;
+  uint32_t prev;
+  uint32_t next;
+  uint16_t slot;       // List the timer is on, or SLOT_NONE when free
+  uint16_t generation; // Bumped on free so stale ids miss
+} Timer;
+
+static Timer *timers = NULL;
+static uint32_t timer_capacity = 0;
+static uint32_t free_head = NIL;
+
+static uint32_t list_head[NUM_LISTS];
+static uint32_t list_tail[NUM_LISTS];
+static int wheel_initialized = 0;
+
+static uint64_t wheel_now;    // Every tick before this has been processed
+static uint32_t pending;      // Timers in wheel slots (not yet expired)
+static uint32_t level0_count; // Timers in level 0 slots
+
+static uint64_t (*clock_override)(void) = NULL;
+
+void timer_set_clock(uint64_t (*clock)(void)) { clock_override = clock; }
+
+uint64_t timer_now_ms(void) {
+  if (clock_override)
+    return clock_override();
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void wheel_init(void) {
+  for (int i = 0; i < NUM_LISTS; i++) {
+    list_head[i] = NIL;
+    list_tail[i] = NIL;
+  }
+  wheel_now = timer_now_ms();
+  wheel_initialized = 1;
+}
+
+static void list_append(uint16_t slot, uint32_t idx) {
+  Timer *t = &timers[idx];
+  t->slot = slot;
+  t->next = NIL;
+  t->prev = list_tail[slot];
+  if (list_tail[slot] != NIL)
+    timers[list_tail[slot]].next = idx;
+  else
+    list_head[slot] = idx;
+  list_tail[slot] = idx;
+
+  if (slot < LEVEL0_SIZE)
+    level0_count++;
+  if (slot < WHEEL_SLOTS)
+    pending++;
+}
+
+static void list_remove(uint32_t idx) {
+  Timer *t = &timers[idx];
+  uint16_t slot = t->slot;
+  if (t->prev != NIL)
+    timers[t->prev].next = t->next;
+  else
+    list_head[slot] = t->next;
+  if (t->next != NIL)
+    timers[t->next].prev = t->prev;
+  else
+    list_tail[slot] = t->prev;
+
+  if (slot < LEVEL0_SIZE)
+    level0_count--;
+  if (slot < WHEEL_SLOTS)
+    pending--;
+  t->slot = SLOT_NONE;
+}
+
+// Place a timer in the slot matching its distance from wheel_now
+static void wheel_insert(uint32_t idx) {
+  uint64_t expires = timers[idx].expires;
+  if (expires < wheel_now) {
+    list_append(EXPIRED_SLOT, idx);
+    return;
+  }
+
+  uint64_t delta = expires - wheel_now;
+  if (delta >= WHEEL_RANGE) {
+    // Park at the far end; re-placed when its slot is cascaded
+    expires = wheel_now + WHEEL_RANGE - 1;
+    delta = WHEEL_RANGE - 1;
+  }
+
+  if (delta < LEVEL0_SIZE) {
+    list_append(expires & LEVEL0_MASK, idx);
+    return;
+  }
+
+  int shift = LEVEL0_BITS;
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    if (level == WHEEL_LEVELS - 1 ||
+        delta < ((uint64_t)1 << (shift + LEVELN_BITS))) {
+      uint16_t slot = LEVEL0_SIZE + (level - 1) * LEVELN_SIZE +
+                      ((expires >> shift) & LEVELN_MASK);
+      list_append(slot, idx);
+      return;
+    }
+    shift += LEVELN_BITS;
+  }
+}
+
+// Re-place every timer of one higher-level slot
+// Returns the slot's index within its level
+static int cascade(int level, uint64_t tick) {
+  int shift = LEVEL0_BITS + (level - 1) * LEVELN_BITS;
+  int index = (tick >> shift) & LEVELN_MASK;
+  uint16_t slot = LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + index;
+
+  uint32_t idx = list_head[slot];
+  while (idx != NIL) {
+    uint32_t next = timers[idx].next;
+    list_remove(idx);
+    wheel_insert(idx);
+    idx = next;
+  }
+  return index;
+}
+
+// Process every tick up to and including now
+static void wheel_advance(uint64_t now) {
+  while (wheel_now <= now) {
+    if (pending == 0) {
+      wheel_now = now + 1;
+      break;
+    }
+
+    uint32_t index = wheel_now & LEVEL0_MASK;
+    if (index == 0) {
+      for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if (cascade(level, wheel_now) != 0)
+          break;
+      }
+    }
+
+    if (level0_count == 0) {
+      // Nothing can expire before the next cascade point
+      uint64_t next = (wheel_now | LEVEL0_MASK) + 1;
+      wheel_now = next < now + 1 ? next : now + 1;
+      continue;
+    }
+
+    uint32_t idx = list_head[index];
+    while (idx != NIL) {
+      uint32_t next = timers[idx].next;
+      list_remove(idx);
+      list_append(EXPIRED_SLOT, idx);
+      idx = next;
+    }
+    wheel_now++;
+  }
+}
+
+static uint32_t timer_alloc(void) {
+  if (free_head == NIL) {
+    if (timer_capacity >= MAX_TIMERS)
+      return NIL;
+    uint32_t cap = timer_capacity ? timer_capacity * 2 : 16;
+    if (cap > MAX_TIMERS)
+      cap = MAX_TIMERS;
+    Timer *grown = realloc(timers, sizeof(Timer) * cap);
+    if (!grown)
+      return NIL;
+    timers = grown;
+    for (uint32_t i = cap; i > timer_capacity; i--) {
+      timers[i - 1].slot = SLOT_NONE;
+      timers[i - 1].generation = 0;
+      timers[i - 1].next = free_head;
+      free_head = i - 1;
+    }
+    timer_capacity = cap;
+  }
+
+  uint32_t idx = free_head;
+  free_head = timers[idx].next;
+  return idx;
+}
+
+static void timer_free(uint32_t idx) {
+  timers[idx].generation = (timers[idx].generation + 1) & 0xfff;
+  timers[idx].slot = SLOT_NONE;
+  timers[idx].next = free_head;
+  free_head = idx;
+}
+
+static TimerId timer_id(uint32_t idx) {
+  return ((TimerId)timers[idx].generation << INDEX_BITS) | (idx + 1);
+}
+
+TimerId timer_add(uint32_t delay_ms, uint32_t interval_ms, TimerCallback cb,
+                  void *userdata) {
+  if (!wheel_initialized)
+    wheel_init();
+
+  uint32_t idx = timer_alloc();
+  if (idx == NIL)
+    return 0;
+
+  Timer *t = &timers[idx];
+  t->expires = timer_now_ms() + delay_ms;
+  t->interval = interval_ms;
+  t->cb = cb;
+  t->userdata = userdata;
+  wheel_insert(idx);
+  return timer_id(idx);
+}
+
+int timer_cancel(TimerId id) {
+  uint32_t idx = (id & INDEX_MASK) - 1;
+  if ((id & INDEX_MASK) == 0 || idx >= timer_capacity)
+    return -1;
+  if (timers[idx].slot == SLOT_NONE ||
+      timers[idx].generation != (id >> INDEX_BITS))
+    return -1;
+
+  list_remove(idx);
+  timer_free(idx);
+  return 0;
+}
+
+int timer_next_timeout(void) {
+  if (!wheel_initialized)
+    return -1;
+
+  uint64_t now = timer_now_ms();
+  wheel_advance(now);
+  if (list_head[EXPIRED_SLOT] != NIL)
+    return 0;
+  if (pending == 0)
+    return -1;
+
+  // Earliest non-empty level 0 slot, or the earliest cascade of a non-empty
+  // higher slot (which may bring timers closer), whichever comes first
+  uint64_t deadline = UINT64_MAX;
+  if (level0_count > 0) {
+    for (uint64_t tick = wheel_now; tick < wheel_now + LEVEL0_SIZE; tick++) {
+      if (list_head[tick & LEVEL0_MASK] != NIL) {
+        deadline = tick;
+        break;
+      }
+    }
+  }
+
+  int shift = LEVEL0_BITS;
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    uint64_t step = (uint64_t)1 << shift;
+    uint64_t tick = (wheel_now + step - 1) & ~(step - 1);
+    int base = LEVEL0_SIZE + (level - 1) * LEVELN_SIZE;
+    for (int k = 0; k < LEVELN_SIZE && tick < deadline; k++, tick += step) {
+      if (list_head[base + ((tick >> shift) & LEVELN_MASK)] != NIL) {
+        deadline = tick;
+        break;
+      }
+    }
+    shift += LEVELN_BITS;
+  }
+
+  if (deadline <= now)
+    return 0;
+  uint64_t wait = deadline - now;
+  return wait > INT32_MAX ? INT32_MAX : (int)wait;
+}
+
+int timer_expire(TimerId *id, void **userdata) {
+  if (!wheel_initialized)
+    return 0;
+
+  wheel_advance(timer_now_ms());
+  uint32_t idx = list_head[EXPIRED_SLOT];
+  if (idx == NIL)
+    return 0;
+
+  Timer *t = &timers[idx];
+  TimerCallback cb = t->cb;
+  *id = timer_id(idx);
+  *userdata = t->userdata;
+
+  list_remove(idx);
+  if (t->interval > 0) {
+    // Re-arm before the callback so it may cancel itself
+    uint64_t now = timer_now_ms();
+    t->expires += t->interval;
+    if (t->expires <= now)
+      t->expires = now + t->interval; // Fell behind: skip missed periods
+    wheel_insert(idx);
+  } else {
+    timer_free(idx);
+  }
+
+  if (cb)
+    cb(*id, *userdata);
+  return 1;
+}
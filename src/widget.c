@@ -1,56 +1,230 @@
 #include "widget.h"
+#include "context.h"
+#include "pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Frame arena
-#define ARENA_SIZE (64 * 1024) // 64KB per frame
+// A list of chunks that is reset, not freed, at every frame. When a frame
+// outgrows it another chunk is linked in and kept, so after the first
+// large frame allocation is a pointer bump again.
+#define ARENA_CHUNK_SIZE (64 * 1024) // 64KB first chunk
+
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  size_t size;   // Usable bytes in data
+  size_t offset; // Bytes used this frame
+  uint8_t data[];
+} ArenaChunk;
 
 typedef struct {
-  uint8_t *buf;
-  size_t size;
-  size_t offset;
+  ArenaChunk *head;
+  ArenaChunk *current;  // Chunk being bumped
+  size_t used_before;   // Bytes used this frame in chunks before current
+  size_t capacity;      // Bytes in all chunks
+  size_t chunk_count;
+  size_t high_water;    // Most bytes used by a single frame
+  size_t failed_allocs; // Allocations refused because malloc failed
 } Arena;
 
-static Arena g_frame_arena;
-static int g_arena_initialized = 0;
+static ArenaChunk *arena_chunk_new(Arena *a, size_t size) {
+  // Double the total each time, so even huge frames link only a few chunks
+  if (size < a->capacity)
+    size = a->capacity;
+  if (size < ARENA_CHUNK_SIZE)
+    size = ARENA_CHUNK_SIZE;
+  ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+  if (!chunk)
+    return NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->offset = 0;
+  a->capacity += size;
+  a->chunk_count++;
+  return chunk;
+}
 
 static void *arena_alloc(Arena *a, size_t size) {
   // Align to 8 bytes
-  size = (size + 7) & ~7;
-  if (a->offset + size > a->size) {
-    return NULL; // Out of memory
+  size = (size + 7) & ~(size_t)7;
+
+  ArenaChunk *chunk = a->current;
+  if (!chunk || chunk->offset + size > chunk->size) {
+    if (chunk)
+      a->used_before += chunk->offset;
+
+    // Move on to the next kept chunk, or link a new one in front of it
+    // when it is too small for this allocation
+    ArenaChunk *next = chunk ? chunk->next : a->head;
+    if (!next || next->size < size) {
+      ArenaChunk *fresh = arena_chunk_new(a, size);
+      if (!fresh) {
+        if (chunk)
+          a->used_before -= chunk->offset;
+        a->failed_allocs++;
+        return NULL; // Out of memory
+      }
+      fresh->next = next;
+      if (chunk)
+        chunk->next = fresh;
+      else
+        a->head = fresh;
+      next = fresh;
+    }
+    next->offset = 0;
+    a->current = chunk = next;
   }
-  void *ptr = a->buf + a->offset;
-  a->offset += size;
+
+  void *ptr = chunk->data + chunk->offset;
+  chunk->offset += size;
+  if (a->used_before + chunk->offset > a->high_water)
+    a->high_water = a->used_before + chunk->offset;
   return ptr;
 }
 
-static void arena_reset(Arena *a) { a->offset = 0; }
+static void arena_reset(Arena *a) {
+  a->current = a->head;
+  a->used_before = 0;
+  if (a->head)
+    a->head->offset = 0;
+}
+
+static void arena_release(Arena *a) {
+  while (a->head) {
+    ArenaChunk *next = a->head->next;
+    free(a->head);
+    a->head = next;
+  }
+  memset(a, 0, sizeof(Arena));
+}
+
+// Result of the layout pass, valid until the next ui_frame_begin
+typedef struct {
+  Rect *rects;     // Area of every widget, indexed by Widget.id
+  Widget **order;  // Laid-out widgets in draw order (parents first)
+  size_t count;    // Entries in order
+  size_t capacity; // Widget ids covered by rects
+  Widget *root;
+
+  // Retained or parallel rendering only (NULL otherwise)
+  uint32_t *extent; // Subtree size in order, indexed like order
+
+  // Retained mode only (NULL otherwise)
+  Widget **match; // Previous frame's counterpart, indexed by Widget.id
+  uint8_t *clean; // Subtree unchanged since last frame, by Widget.id
+  Widget **keys;  // Keyed widgets, open addressing on the key
+  size_t key_mask;
+} FrameLayout;
+
+// Everything a context keeps between calls (see ttykit_ctx_create)
+struct UiState {
+  // Two arenas: in retained mode the previous frame's tree stays alive in
+  // one while the next frame is built in the other
+  Arena arenas[2];
+  Arena *arena;
+
+  // Widgets built this frame; each gets the next id
+  uint32_t widget_count;
+  size_t max_children; // Largest box, sizes the layout scratch
+
+  // Widgets given a key this frame (sizes the key table)
+  size_t keyed_count;
+
+  // VERSIONED widgets built this frame (reconciled even outside retained
+  // mode)
+  size_t versioned_count;
+
+  FrameLayout layout;
+  FrameLayout prev; // Previous frame's layout (retained mode)
+  int retained;
+
+  Cell *snapshot; // Cells drawn by the previous frame
+  int snapshot_rows;
+  int snapshot_cols;
+
+  // Root area of the previous frame, to invalidate cached splits on resize
+  Rect last_root;
+};
+
+static UiState g_default_ui = {.arena = &g_default_ui.arenas[0]};
+static UiState *g_ui = &g_default_ui;
+
+static TaskPool *g_pool = NULL; // Parallel rendering (NULL = off)
+
+UiState *ui_state_create(void) {
+  UiState *state = calloc(1, sizeof(UiState));
+  if (state)
+    state->arena = &state->arenas[0];
+  return state;
+}
+
+void ui_state_destroy(UiState *state) {
+  if (!state)
+    return;
+  if (g_ui == state)
+    g_ui = &g_default_ui;
+  arena_release(&state->arenas[0]);
+  arena_release(&state->arenas[1]);
+  free(state->snapshot);
+  free(state);
+}
+
+void ui_state_bind(UiState *state) { g_ui = state ? state : &g_default_ui; }
 
 void ui_frame_begin(void) {
-  if (!g_arena_initialized) {
-    g_frame_arena.buf = malloc(ARENA_SIZE);
-    g_frame_arena.size = ARENA_SIZE;
-    g_frame_arena.offset = 0;
-    g_arena_initialized = 1;
+  UiState *ui = g_ui;
+  if (ui->retained || ui->layout.clean) {
+    // Keep the last frame's tree and layout (if it was reconciled); build
+    // into the other arena
+    ui->prev = ui->layout;
+    ui->arena = (ui->arena == &ui->arenas[0]) ? &ui->arenas[1] : &ui->arenas[0];
+  } else {
+    ui->prev.count = 0;
   }
-  arena_reset(&g_frame_arena);
+  arena_reset(ui->arena);
+  ui->widget_count = 0;
+  ui->max_children = 0;
+  ui->keyed_count = 0;
+  ui->versioned_count = 0;
+  ui->layout.count = 0;
+  ui->layout.capacity = 0;
+  ui->layout.clean = NULL;
 }
 
 void ui_frame_end(void) {
   // No-op for now, reserved for future use
 }
 
+void ui_arena_stats(ArenaStats *stats) {
+  const Arena *a = g_ui->arena;
+  stats->used = a->used_before + (a->current ? a->current->offset : 0);
+  stats->high_water = a->high_water;
+  stats->capacity = a->capacity;
+  stats->chunks = a->chunk_count;
+  stats->failed_allocs = a->failed_allocs;
+}
+
 // Widget constructors
 
-Widget *widget_vbox(Constraint c, Widget **children) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+static Widget *widget_alloc(WidgetType type, Constraint c) {
+  Widget *w = arena_alloc(g_ui->arena, sizeof(Widget));
   if (!w)
     return NULL;
 
-  w->type = WIDGET_VBOX;
+  w->type = type;
   w->constraint = c;
+  w->id = g_ui->widget_count++;
+  w->key = 0;
+  w->version = 0;
+  w->versioned = 0;
+  return w;
+}
+
+Widget *widget_vbox(Constraint c, Widget **children) {
+  Widget *w = widget_alloc(WIDGET_VBOX, c);
+  if (!w)
+    return NULL;
 
   // Count children
   size_t count = 0;
@@ -58,57 +232,99 @@ Widget *widget_vbox(Constraint c, Widget **children) {
     count++;
 
   // Copy children array
-  w->box.children = arena_alloc(&g_frame_arena, sizeof(Widget *) * count);
+  w->box.children = arena_alloc(g_ui->arena, sizeof(Widget *) * count);
   if (!w->box.children)
     return NULL;
   memcpy(w->box.children, children, sizeof(Widget *) * count);
   w->box.count = count;
+  if (count > g_ui->max_children)
+    g_ui->max_children = count;
 
   return w;
 }
 
 Widget *widget_hbox(Constraint c, Widget **children) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_HBOX, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_HBOX;
-  w->constraint = c;
-
   // Count children
   size_t count = 0;
   while (children[count] != NULL)
     count++;
 
   // Copy children array
-  w->box.children = arena_alloc(&g_frame_arena, sizeof(Widget *) * count);
+  w->box.children = arena_alloc(g_ui->arena, sizeof(Widget *) * count);
   if (!w->box.children)
     return NULL;
   memcpy(w->box.children, children, sizeof(Widget *) * count);
   w->box.count = count;
+  if (count > g_ui->max_children)
+    g_ui->max_children = count;
+
+  return w;
+}
+
+Widget *widget_grid(Constraint c, const Constraint *rows, size_t row_count,
+                    const Constraint *cols, size_t col_count,
+                    const GridCell *cells) {
+  Widget *w = widget_alloc(WIDGET_GRID, c);
+  if (!w)
+    return NULL;
+
+  // Count cells
+  size_t count = 0;
+  while (cells[count].widget != NULL)
+    count++;
+
+  // Copy tracks and cells (callers usually pass compound literals)
+  w->grid.rows = arena_alloc(g_ui->arena, sizeof(Constraint) * row_count);
+  w->grid.cols = arena_alloc(g_ui->arena, sizeof(Constraint) * col_count);
+  w->grid.cells = arena_alloc(g_ui->arena, sizeof(GridCell) * count);
+  if (!w->grid.rows || !w->grid.cols || !w->grid.cells)
+    return NULL;
+  memcpy(w->grid.rows, rows, sizeof(Constraint) * row_count);
+  memcpy(w->grid.cols, cols, sizeof(Constraint) * col_count);
+  memcpy(w->grid.cells, cells, sizeof(GridCell) * count);
+  w->grid.row_count = row_count;
+  w->grid.col_count = col_count;
+  w->grid.count = count;
+  if (row_count + col_count > g_ui->max_children)
+    g_ui->max_children = row_count + col_count;
 
   return w;
 }
 
 Widget *widget_text(Constraint c, const char *text) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_TEXT, c);
+  if (!w)
+    return NULL;
+
+  w->text.text = text;
+  w->text.length = SIZE_MAX;
+  w->text.first_line = 0;
+
+  return w;
+}
+
+Widget *widget_text_span(Constraint c, const char *text, size_t length,
+                         size_t first_line) {
+  Widget *w = widget_alloc(WIDGET_TEXT, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_TEXT;
-  w->constraint = c;
   w->text.text = text;
+  w->text.length = length;
+  w->text.first_line = first_line;
 
   return w;
 }
 
 Widget *widget_block(Constraint c, const char *title, Widget *child) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_BLOCK, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_BLOCK;
-  w->constraint = c;
   w->block.title = title;
   w->block.child = child;
 
@@ -117,50 +333,54 @@ Widget *widget_block(Constraint c, const char *title, Widget *child) {
 
 Widget *widget_list(Constraint c, const char **items, const Color *colors,
                     size_t count, size_t selected) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_LIST, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_LIST;
-  w->constraint = c;
   w->list.items = items;
   w->list.colors = colors;
   w->list.count = count;
   w->list.selected = selected;
+  w->list.item_fn = NULL;
+  w->list.userdata = NULL;
+  w->list.scroll = NULL;
+  w->list.offset = 0;
 
   return w;
 }
 
-Widget *widget_vline(Constraint c) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+Widget *widget_list_virtual(Constraint c, ListItemFn item_fn, void *userdata,
+                            size_t count, size_t selected, size_t *scroll) {
+  Widget *w = widget_alloc(WIDGET_LIST, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_VLINE;
-  w->constraint = c;
+  w->list.items = NULL;
+  w->list.colors = NULL;
+  w->list.count = count;
+  w->list.selected = selected;
+  w->list.item_fn = item_fn;
+  w->list.userdata = userdata;
+  w->list.scroll = scroll;
+  w->list.offset = scroll ? *scroll : 0;
 
   return w;
 }
 
-Widget *widget_hline(Constraint c) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
-  if (!w)
-    return NULL;
-
-  w->type = WIDGET_HLINE;
-  w->constraint = c;
+Widget *widget_vline(Constraint c) {
+  return widget_alloc(WIDGET_VLINE, c);
+}
 
-  return w;
+Widget *widget_hline(Constraint c) {
+  return widget_alloc(WIDGET_HLINE, c);
 }
 
 Widget *widget_input(Constraint c, const char *text, size_t cursor,
                      const char *prompt) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_INPUT, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_INPUT;
-  w->constraint = c;
   w->input.text = text ? text : "";
   w->input.cursor = cursor;
   w->input.prompt = prompt;
@@ -170,12 +390,10 @@ Widget *widget_input(Constraint c, const char *text, size_t cursor,
 
 Widget *widget_gauge(Constraint c, double value, const char *label,
                      Color color) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_GAUGE, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_GAUGE;
-  w->constraint = c;
   w->gauge.value = value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
   w->gauge.label = label;
   w->gauge.color = color;
@@ -185,15 +403,30 @@ Widget *widget_gauge(Constraint c, double value, const char *label,
 
 Widget *widget_sparkline(Constraint c, const double *data, size_t count,
                          Color color) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_SPARKLINE, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_SPARKLINE;
-  w->constraint = c;
   w->sparkline.data = data;
   w->sparkline.count = count;
   w->sparkline.color = color;
+  w->sparkline.series = NULL;
+  w->sparkline.total = 0;
+
+  return w;
+}
+
+Widget *widget_sparkline_series(Constraint c, const TimeSeries *series,
+                                Color color) {
+  Widget *w = widget_alloc(WIDGET_SPARKLINE, c);
+  if (!w)
+    return NULL;
+
+  w->sparkline.data = NULL;
+  w->sparkline.count = 0;
+  w->sparkline.color = color;
+  w->sparkline.series = series;
+  w->sparkline.total = series ? time_series_total(series) : 0;
 
   return w;
 }
@@ -201,29 +434,68 @@ Widget *widget_sparkline(Constraint c, const double *data, size_t count,
 Widget *widget_table(Constraint c, const char **headers, const char ***rows,
                      size_t col_count, size_t row_count,
                      const uint16_t *widths) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_TABLE, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_TABLE;
-  w->constraint = c;
   w->table.headers = headers;
   w->table.rows = rows;
   w->table.col_count = col_count;
   w->table.row_count = row_count;
   w->table.widths = widths;
+  w->table.cell_fn = NULL;
+  w->table.userdata = NULL;
+  w->table.selected = SIZE_MAX;
+  w->table.state = NULL;
+  w->table.row_offset = 0;
+  w->table.col_offset = 0;
+
+  return w;
+}
+
+Widget *widget_table_virtual(Constraint c, const char **headers,
+                             TableCellFn cell_fn, void *userdata,
+                             size_t col_count, size_t row_count,
+                             size_t selected, TableState *state) {
+  Widget *w = widget_alloc(WIDGET_TABLE, c);
+  if (!w)
+    return NULL;
+
+  w->table.headers = headers;
+  w->table.rows = NULL;
+  w->table.col_count = col_count;
+  w->table.row_count = row_count;
+  w->table.widths = NULL;
+  w->table.cell_fn = cell_fn;
+  w->table.userdata = userdata;
+  w->table.selected = selected;
+  w->table.state = state;
+  w->table.row_offset = state ? state->row_offset : 0;
+  w->table.col_offset = state ? state->col_offset : 0;
+
+  return w;
+}
+
+Widget *widget_log(Constraint c, const LogRing *ring, LogState *state) {
+  Widget *w = widget_alloc(WIDGET_LOG, c);
+  if (!w)
+    return NULL;
+
+  w->log.ring = ring;
+  w->log.state = state;
+  w->log.total = ring ? log_ring_total(ring) : 0;
+  w->log.top = state ? state->top : 0;
+  w->log.hold = state ? state->hold : 0;
 
   return w;
 }
 
 Widget *widget_checkbox(Constraint c, const char **items, const int *checked,
                         size_t count, size_t selected) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_CHECKBOX, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_CHECKBOX;
-  w->constraint = c;
   w->checkbox.items = items;
   w->checkbox.checked = checked;
   w->checkbox.count = count;
@@ -234,12 +506,10 @@ Widget *widget_checkbox(Constraint c, const char **items, const int *checked,
 
 Widget *widget_progress(Constraint c, double value, const char *label,
                         int show_percent) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_PROGRESS, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_PROGRESS;
-  w->constraint = c;
   w->progress.value = value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
   w->progress.label = label;
   w->progress.show_percent = show_percent;
@@ -249,12 +519,10 @@ Widget *widget_progress(Constraint c, double value, const char *label,
 
 Widget *widget_tabs(Constraint c, const char **labels, size_t count,
                     size_t selected) {
-  Widget *w = arena_alloc(&g_frame_arena, sizeof(Widget));
+  Widget *w = widget_alloc(WIDGET_TABS, c);
   if (!w)
     return NULL;
 
-  w->type = WIDGET_TABS;
-  w->constraint = c;
   w->tabs.labels = labels;
   w->tabs.count = count;
   w->tabs.selected = selected;
@@ -262,6 +530,39 @@ Widget *widget_tabs(Constraint c, const char **labels, size_t count,
   return w;
 }
 
+Widget *widget_set_key(Widget *w, uint32_t key) {
+  if (w) {
+    if (key != 0 && w->key == 0)
+      g_ui->keyed_count++;
+    w->key = key;
+  }
+  return w;
+}
+
+Widget *widget_set_version(Widget *w, uint32_t version) {
+  if (w)
+    w->version = version;
+  return w;
+}
+
+Widget *widget_set_versioned(Widget *w, uint32_t version) {
+  if (w) {
+    if (!w->versioned)
+      g_ui->versioned_count++;
+    w->version = version;
+    w->versioned = 1;
+  }
+  return w;
+}
+
+uint32_t widget_hash(uint32_t hash, const void *data, size_t len) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 16777619u;
+  }
+  return hash;
+}
+
 void widget_list_set_selected(Widget *w, size_t selected) {
   if (w && w->type == WIDGET_LIST) {
     w->list.selected = selected;
@@ -270,75 +571,129 @@ void widget_list_set_selected(Widget *w, size_t selected) {
 
 // Rendering
 
-void widget_render(Widget *w, Buffer *buf, Rect area) {
-  if (!w || rect_is_empty(area))
-    return;
+// First visible list row: the previous offset, moved just enough to keep
+// the selection in view and clamped so the window never runs past the end
+static size_t list_first_row(size_t offset, size_t selected, size_t count,
+                             uint16_t height) {
+  if (height == 0)
+    return offset;
+  if (selected < count) {
+    if (selected < offset)
+      offset = selected;
+    else if (selected - offset >= height)
+      offset = selected - height + 1;
+  }
+  if (count <= height)
+    return 0;
+  return offset > count - height ? count - height : offset;
+}
 
-  switch (w->type) {
-  case WIDGET_VBOX:
-  case WIDGET_HBOX: {
-    Direction dir =
-        (w->type == WIDGET_VBOX) ? DIRECTION_VERTICAL : DIRECTION_HORIZONTAL;
+// Sparkline character for a value in 0.0 to 1.0
+// Sparkline uses Unicode block characters: ▁▂▃▄▅▆▇█
+// For simplicity, use ASCII: _ . - = #
+static char sparkline_level(double val) {
+  static const char levels[] = " ._-=*#";
+  size_t num_levels = sizeof(levels) - 1;
+  if (val < 0.0)
+    val = 0.0;
+  if (val > 1.0)
+    val = 1.0;
+  return levels[(size_t)(val * (num_levels - 1))];
+}
 
-    size_t n = w->box.count;
-    if (n == 0)
-      return;
+// End of the line starting at p (its '\n', NUL or end)
+static const char *text_line_end(const char *p, const char *end) {
+  if (!end)
+    return p + strcspn(p, "\n");
+  const char *nl = memchr(p, '\n', end - p);
+  return nl ? nl : end;
+}
 
-    // Build constraints array from children
-    Constraint *constraints =
-        arena_alloc(&g_frame_arena, sizeof(Constraint) * n);
-    Rect *areas = arena_alloc(&g_frame_arena, sizeof(Rect) * n);
-    if (!constraints || !areas)
-      return;
+// Start of the line after the one ending at line_end (NULL if none)
+static const char *text_next_line(const char *line_end, const char *end) {
+  if (line_end == end || *line_end != '\n')
+    return NULL;
+  return line_end + 1;
+}
 
-    for (size_t i = 0; i < n; i++) {
-      constraints[i] = w->box.children[i]->constraint;
-    }
+#define TABLE_GAP 2           // Blank cells after auto-sized columns
+#define TABLE_SAMPLE_ROWS 100 // Leading rows measured into a width cache
 
-    if (layout_split(area, dir, constraints, n, areas) < 0) {
-      return; // Layout failed
-    }
+static const char *table_cell(const Widget *w, size_t row, size_t col) {
+  if (w->table.cell_fn)
+    return w->table.cell_fn(w->table.userdata, row, col);
+  if (!w->table.rows || !w->table.rows[row])
+    return NULL;
+  return w->table.rows[row][col];
+}
 
-    // Render children
-    for (size_t i = 0; i < n; i++) {
-      widget_render(w->box.children[i], buf, areas[i]);
-    }
-    break;
+// Text width in cells, saturated to what a column can hold
+static size_t table_text_width(const char *text) {
+  size_t n = 0;
+  if (text) {
+    while (text[n] && n < UINT16_MAX - TABLE_GAP)
+      n++;
   }
+  return n;
+}
 
-  case WIDGET_TEXT: {
-    const char *text = w->text.text;
-    if (!text)
-      break;
+// Width of a column: fixed, or measured from the header and the visible
+// cells. A cached width is seeded from the first TABLE_SAMPLE_ROWS rows and
+// then only grows as wider cells scroll into view.
+static size_t table_column_width(const Widget *w, size_t col,
+                                 const size_t *visible_lens, size_t visible) {
+  if (w->table.widths)
+    return w->table.widths[col];
+
+  uint16_t *cache = w->table.state ? w->table.state->widths : NULL;
+  size_t width = cache ? cache[col] : 0;
+  if (width == 0) {
+    width = table_text_width(w->table.headers[col]);
+    if (cache) {
+      size_t n = w->table.row_count < TABLE_SAMPLE_ROWS ? w->table.row_count
+                                                        : TABLE_SAMPLE_ROWS;
+      for (size_t r = 0; r < n; r++) {
+        size_t len = table_text_width(table_cell(w, r, col));
+        if (len > width)
+          width = len;
+      }
+    }
+    width += TABLE_GAP;
+  }
+  for (size_t r = 0; r < visible; r++) {
+    size_t len = visible_lens[r] + TABLE_GAP;
+    if (len > width)
+      width = len;
+  }
 
-    uint16_t row = 0;
-    const char *line_start = text;
+  if (cache)
+    cache[col] = width;
+  return width;
+}
 
-    while (*line_start && row < area.height) {
-      // Find end of line
-      const char *line_end = line_start;
-      while (*line_end && *line_end != '\n') {
-        line_end++;
-      }
+// Draw one widget into its own area (children are drawn by the caller)
+// Temporary rows and cells come from scratch.
+static void render_self(Widget *w, Buffer *buf, Rect area, Arena *scratch) {
+  switch (w->type) {
+  case WIDGET_VBOX:
+  case WIDGET_HBOX:
+  case WIDGET_GRID:
+    break; // Containers only position their children
 
-      // Copy line to temporary buffer for rendering
-      size_t line_len = line_end - line_start;
-      char line[256];
-      if (line_len > sizeof(line) - 1) {
-        line_len = sizeof(line) - 1;
-      }
-      memcpy(line, line_start, line_len);
-      line[line_len] = '\0';
+  case WIDGET_TEXT: {
+    const char *p = w->text.text;
+    if (!p)
+      break;
 
-      buffer_set_str(buf, area.y + row, area.x, line);
-      row++;
+    // Lines are blitted straight from the text, clipped to the area
+    const char *end = w->text.length == SIZE_MAX ? NULL : p + w->text.length;
+    for (size_t skip = w->text.first_line; skip > 0 && p; skip--)
+      p = text_next_line(text_line_end(p, end), end);
 
-      // Move to next line
-      if (*line_end == '\n') {
-        line_start = line_end + 1;
-      } else {
-        break;
-      }
+    for (uint16_t row = 0; p && row < area.height; row++) {
+      const char *line_end = text_line_end(p, end);
+      buffer_set_span(buf, area.y + row, area.x, p, line_end - p, area.width);
+      p = text_next_line(line_end, end);
     }
     break;
   }
@@ -349,10 +704,8 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
     // Draw top border
     buffer_set_cell_styled(buf, area.y, area.x, '+', border_color,
                            COLOR_DEFAULT_INIT, ATTR_NONE);
-    for (uint16_t c = area.x + 1; c < area.x + area.width - 1; c++) {
-      buffer_set_cell_styled(buf, area.y, c, '-', border_color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-    }
+    buffer_fill_rect(buf, area.y, area.x + 1, 1, area.width - 2, '-',
+                     border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
     if (area.width > 1) {
       buffer_set_cell_styled(buf, area.y, area.x + area.width - 1, '+',
                              border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
@@ -368,22 +721,20 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
 
       buffer_set_cell_styled(buf, area.y, area.x + 1, ' ', COLOR_DEFAULT_INIT,
                              COLOR_DEFAULT_INIT, ATTR_NONE);
-      for (size_t i = 0; i < title_len; i++) {
-        buffer_set_cell_styled(buf, area.y, area.x + 2 + i, title[i],
-                               COLOR_INDEX(11), COLOR_DEFAULT_INIT, ATTR_BOLD);
-      }
+      buffer_set_span_styled(buf, area.y, area.x + 2, title, title_len,
+                             title_len, COLOR_INDEX(11), COLOR_DEFAULT_INIT,
+                             ATTR_BOLD);
       buffer_set_cell_styled(buf, area.y, area.x + 2 + title_len, ' ',
                              COLOR_DEFAULT_INIT, COLOR_DEFAULT_INIT, ATTR_NONE);
     }
 
     // Draw side borders
-    for (uint16_t r = area.y + 1; r < area.y + area.height - 1; r++) {
-      buffer_set_cell_styled(buf, r, area.x, '|', border_color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-      if (area.width > 1) {
-        buffer_set_cell_styled(buf, r, area.x + area.width - 1, '|',
-                               border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
-      }
+    buffer_fill_rect(buf, area.y + 1, area.x, area.height - 2, 1, '|',
+                     border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
+    if (area.width > 1) {
+      buffer_fill_rect(buf, area.y + 1, area.x + area.width - 1,
+                       area.height - 2, 1, '|', border_color,
+                       COLOR_DEFAULT_INIT, ATTR_NONE);
     }
 
     // Draw bottom border
@@ -391,25 +742,14 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
       uint16_t bottom = area.y + area.height - 1;
       buffer_set_cell_styled(buf, bottom, area.x, '+', border_color,
                              COLOR_DEFAULT_INIT, ATTR_NONE);
-      for (uint16_t c = area.x + 1; c < area.x + area.width - 1; c++) {
-        buffer_set_cell_styled(buf, bottom, c, '-', border_color,
-                               COLOR_DEFAULT_INIT, ATTR_NONE);
-      }
+      buffer_fill_rect(buf, bottom, area.x + 1, 1, area.width - 2, '-',
+                       border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
       if (area.width > 1) {
         buffer_set_cell_styled(buf, bottom, area.x + area.width - 1, '+',
                                border_color, COLOR_DEFAULT_INIT, ATTR_NONE);
       }
     }
 
-    // Render child in inner area
-    Widget *child = w->block.child;
-    if (child && area.width > 2 && area.height > 2) {
-      Rect inner = {.x = area.x + 1,
-                    .y = area.y + 1,
-                    .width = area.width - 2,
-                    .height = area.height - 2};
-      widget_render(child, buf, inner);
-    }
     break;
   }
 
@@ -419,50 +759,55 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
     size_t count = w->list.count;
     size_t selected = w->list.selected;
 
-    if (!items)
+    if (!items && !w->list.item_fn)
       break;
 
-    for (size_t i = 0; i < count && i < area.height; i++) {
-      const char *item = items[i];
+    // Only the visible window is fetched, whatever the item count
+    size_t first = list_first_row(w->list.offset, selected, count, area.height);
+    if (w->list.scroll)
+      *w->list.scroll = first;
+
+    for (size_t row = 0; row < area.height && first + row < count; row++) {
+      size_t i = first + row;
+      Color item_color = COLOR_DEFAULT_INIT;
+      const char *item;
+      if (w->list.item_fn) {
+        item = w->list.item_fn(w->list.userdata, i, &item_color);
+      } else {
+        item = items[i];
+        if (colors && colors[i].type != COLOR_DEFAULT)
+          item_color = colors[i];
+      }
       if (!item)
         continue;
 
       int is_selected = (i == selected);
-      Color item_color = (colors && colors[i].type != COLOR_DEFAULT)
-                             ? colors[i]
-                             : COLOR_DEFAULT_INIT;
       Color fg = is_selected ? COLOR_INDEX(0) : item_color;
       Color bg = is_selected ? COLOR_INDEX(14) : COLOR_DEFAULT_INIT;
       uint8_t attrs = is_selected ? ATTR_BOLD : ATTR_NONE;
 
       // Fill row with background if selected
-      if (is_selected) {
-        for (uint16_t c = area.x; c < area.x + area.width; c++) {
-          buffer_set_cell_styled(buf, area.y + i, c, ' ', fg, bg, attrs);
-        }
-      }
+      if (is_selected)
+        buffer_fill_rect(buf, area.y + row, area.x, 1, area.width, ' ', fg, bg,
+                         attrs);
 
       // Draw item text
-      buffer_set_str_styled(buf, area.y + i, area.x, item, fg, bg, attrs);
+      buffer_set_str_styled(buf, area.y + row, area.x, item, fg, bg, attrs);
     }
     break;
   }
 
   case WIDGET_VLINE: {
     Color line_color = COLOR_INDEX(8); // Gray
-    for (uint16_t r = area.y; r < area.y + area.height; r++) {
-      buffer_set_cell_styled(buf, r, area.x, '|', line_color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-    }
+    buffer_fill_rect(buf, area.y, area.x, area.height, 1, '|', line_color,
+                     COLOR_DEFAULT_INIT, ATTR_NONE);
     break;
   }
 
   case WIDGET_HLINE: {
     Color line_color = COLOR_INDEX(8); // Gray
-    for (uint16_t c = area.x; c < area.x + area.width; c++) {
-      buffer_set_cell_styled(buf, area.y, c, '-', line_color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-    }
+    buffer_fill_rect(buf, area.y, area.x, 1, area.width, '-', line_color,
+                     COLOR_DEFAULT_INIT, ATTR_NONE);
     break;
   }
 
@@ -526,81 +871,146 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
     // Draw filled portion
     size_t inner_width = bar_width - 2;
     size_t filled = (size_t)(w->gauge.value * inner_width);
-    for (size_t i = 0; i < inner_width; i++) {
-      char ch = (i < filled) ? '=' : ' ';
-      buffer_set_cell_styled(buf, area.y, bar_start + 1 + i, ch, w->gauge.color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-    }
+    if (filled > inner_width)
+      filled = inner_width;
+    buffer_fill_rect(buf, area.y, bar_start + 1, 1, filled, '=',
+                     w->gauge.color, COLOR_DEFAULT_INIT, ATTR_NONE);
+    buffer_fill_rect(buf, area.y, bar_start + 1 + filled, 1,
+                     inner_width - filled, ' ', w->gauge.color,
+                     COLOR_DEFAULT_INIT, ATTR_NONE);
     break;
   }
 
   case WIDGET_SPARKLINE: {
-    // Sparkline uses Unicode block characters: ▁▂▃▄▅▆▇█
-    // For simplicity, use ASCII: _ . - = #
-    static const char levels[] = " ._-=*#";
-    size_t num_levels = sizeof(levels) - 1;
+    const TimeSeries *series = w->sparkline.series;
+    size_t n = series ? time_series_count(series) : w->sparkline.count;
+    if ((!series && !w->sparkline.data) || n == 0)
+      break;
 
-    if (!w->sparkline.data || w->sparkline.count == 0)
+    // Levels are gathered into one row and written as a single span
+    size_t display_count = area.width < n ? area.width : n;
+    char *line = arena_alloc(scratch, display_count);
+    if (!line)
       break;
 
-    size_t data_count = w->sparkline.count;
-    size_t display_count = area.width < data_count ? area.width : data_count;
-    size_t start_idx =
-        data_count > display_count ? data_count - display_count : 0;
-
-    for (size_t i = 0; i < display_count; i++) {
-      double val = w->sparkline.data[start_idx + i];
-      if (val < 0.0)
-        val = 0.0;
-      if (val > 1.0)
-        val = 1.0;
-      size_t level = (size_t)(val * (num_levels - 1));
-      buffer_set_cell_styled(buf, area.y, area.x + i, levels[level],
-                             w->sparkline.color, COLOR_DEFAULT_INIT, ATTR_NONE);
+    if (series) {
+      // Decimate to one sample per column: each column shows the peak of
+      // its share of the history, so spikes survive any compression
+      for (size_t i = 0; i < display_count; i++) {
+        size_t first = (uint64_t)i * n / display_count;
+        size_t last = (uint64_t)(i + 1) * n / display_count;
+        double min, max = 0.0;
+        time_series_range(series, first, last - first, &min, &max);
+        line[i] = sparkline_level(max);
+      }
+    } else {
+      // Array data shows the newest points
+      const double *data = w->sparkline.data + (n - display_count);
+      for (size_t i = 0; i < display_count; i++)
+        line[i] = sparkline_level(data[i]);
     }
+
+    buffer_set_span_styled(buf, area.y, area.x, line, display_count,
+                           display_count, w->sparkline.color,
+                           COLOR_DEFAULT_INIT, ATTR_NONE);
     break;
   }
 
   case WIDGET_TABLE: {
-    if (!w->table.headers || w->table.col_count == 0)
+    size_t col_count = w->table.col_count;
+    if (!w->table.headers || col_count == 0 || area.height == 0)
       break;
 
-    // Calculate column widths
-    size_t *col_widths =
-        arena_alloc(&g_frame_arena, sizeof(size_t) * w->table.col_count);
-    if (!col_widths)
+    // Only the visible window of rows and columns is fetched
+    TableState *state = w->table.state;
+    uint16_t body = area.height - 1;
+    size_t first = list_first_row(w->table.row_offset, w->table.selected,
+                                  w->table.row_count, body);
+    size_t visible = w->table.row_count - first;
+    if (visible > body)
+      visible = body;
+    size_t first_col =
+        w->table.col_offset < col_count ? w->table.col_offset : col_count - 1;
+    if (state) {
+      state->row_offset = first;
+      state->col_offset = first_col;
+    }
+
+    // Cells are copied out as they are fetched, so a provider may reuse one
+    // buffer. No cell shows more than the table's width.
+    char *texts = arena_alloc(scratch, (size_t)visible * area.width + 1);
+    size_t *lens = arena_alloc(scratch, sizeof(size_t) * (visible + 1));
+    if (!texts || !lens)
       break;
 
-    for (size_t c = 0; c < w->table.col_count; c++) {
-      if (w->table.widths) {
-        col_widths[c] = w->table.widths[c];
-      } else {
-        // Auto-calculate: use header length + 2
-        col_widths[c] = strlen(w->table.headers[c]) + 2;
-      }
-    }
+    size_t sel = w->table.selected;
+    int has_sel = sel >= first && sel - first < visible;
+    Color sel_fg = COLOR_INDEX(0);
+    Color sel_bg = COLOR_INDEX(14);
+    if (has_sel)
+      buffer_fill_rect(buf, area.y + 1 + (sel - first), area.x, 1, area.width,
+                       ' ', sel_fg, sel_bg, ATTR_BOLD);
 
-    // Render header
     size_t col_x = area.x;
-    for (size_t c = 0; c < w->table.col_count && col_x < area.x + area.width;
+    for (size_t c = first_col; c < col_count && col_x < area.x + area.width;
          c++) {
-      buffer_set_str_styled(buf, area.y, col_x, w->table.headers[c],
-                            COLOR_INDEX(14), COLOR_DEFAULT_INIT, ATTR_BOLD);
-      col_x += col_widths[c];
+      for (size_t r = 0; r < visible; r++) {
+        const char *text = table_cell(w, first + r, c);
+        lens[r] = table_text_width(text);
+        if (text)
+          memcpy(texts + r * area.width, text,
+                 lens[r] < area.width ? lens[r] : area.width);
+      }
+      size_t width = table_column_width(w, c, lens, visible);
+      size_t clip = area.x + area.width - col_x;
+      if (width < clip)
+        clip = width;
+
+      // Each cell is clipped to its column
+      const char *header = w->table.headers[c];
+      buffer_set_span_styled(buf, area.y, col_x, header,
+                             table_text_width(header), clip, COLOR_INDEX(14),
+                             COLOR_DEFAULT_INIT, ATTR_BOLD);
+      for (size_t r = 0; r < visible; r++) {
+        int is_selected = has_sel && first + r == sel;
+        size_t len = lens[r] < area.width ? lens[r] : area.width;
+        buffer_set_span_styled(buf, area.y + 1 + r, col_x,
+                               texts + r * area.width, len, clip,
+                               is_selected ? sel_fg : COLOR_DEFAULT_INIT,
+                               is_selected ? sel_bg : COLOR_DEFAULT_INIT,
+                               is_selected ? ATTR_BOLD : ATTR_NONE);
+      }
+      col_x += width;
     }
+    break;
+  }
 
-    // Render rows
-    for (size_t r = 0; r < w->table.row_count && r + 1 < area.height; r++) {
-      if (!w->table.rows[r])
-        continue;
-      col_x = area.x;
-      for (size_t c = 0; c < w->table.col_count && col_x < area.x + area.width;
-           c++) {
-        if (w->table.rows[r][c]) {
-          buffer_set_str(buf, area.y + 1 + r, col_x, w->table.rows[r][c]);
-        }
-        col_x += col_widths[c];
-      }
+  case WIDGET_LOG: {
+    const LogRing *ring = w->log.ring;
+    if (!ring)
+      break;
+
+    // Only the visible lines are touched, however long the log has run
+    uint64_t total = log_ring_total(ring);
+    uint64_t oldest = total - log_ring_count(ring);
+    uint64_t tail = total - oldest > area.height ? total - area.height : oldest;
+    uint64_t top = tail;
+    if (w->log.hold) {
+      top = w->log.top < oldest ? oldest : w->log.top;
+      if (top > tail)
+        top = tail;
+    }
+    if (w->log.state) {
+      w->log.state->top = top;
+      if (top == tail)
+        w->log.state->hold = 0; // Back at the newest lines
+    }
+
+    for (uint16_t row = 0; row < area.height && top + row < total; row++) {
+      size_t len;
+      const char *line = log_ring_line(ring, top + row, &len);
+      if (line)
+        buffer_set_span(buf, area.y + row, area.x, line, len, area.width);
     }
     break;
   }
@@ -624,11 +1034,9 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
       uint8_t attrs = is_selected ? ATTR_BOLD : ATTR_NONE;
 
       // Fill row with background if selected
-      if (is_selected) {
-        for (uint16_t c = area.x; c < area.x + area.width; c++) {
-          buffer_set_cell_styled(buf, area.y + i, c, ' ', fg, bg, attrs);
-        }
-      }
+      if (is_selected)
+        buffer_fill_rect(buf, area.y + i, area.x, 1, area.width, ' ', fg, bg,
+                         attrs);
 
       // Draw checkbox and label
       buffer_set_str_styled(buf, area.y + i, area.x, box, fg, bg, attrs);
@@ -667,12 +1075,13 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
 
     size_t inner_width = bar_width - 2;
     size_t filled = (size_t)(w->progress.value * inner_width);
-    for (size_t i = 0; i < inner_width; i++) {
-      char ch = (i < filled) ? '#' : '-';
-      Color color = (i < filled) ? COLOR_INDEX(10) : COLOR_INDEX(8);
-      buffer_set_cell_styled(buf, area.y, bar_start + 1 + i, ch, color,
-                             COLOR_DEFAULT_INIT, ATTR_NONE);
-    }
+    if (filled > inner_width)
+      filled = inner_width;
+    buffer_fill_rect(buf, area.y, bar_start + 1, 1, filled, '#',
+                     COLOR_INDEX(10), COLOR_DEFAULT_INIT, ATTR_NONE);
+    buffer_fill_rect(buf, area.y, bar_start + 1 + filled, 1,
+                     inner_width - filled, '-', COLOR_INDEX(8),
+                     COLOR_DEFAULT_INIT, ATTR_NONE);
 
     // Draw percentage
     if (w->progress.show_percent) {
@@ -696,35 +1105,18 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
       size_t label_len = strlen(label);
       int is_selected = (i == w->tabs.selected);
 
-      // Draw tab with padding
-      if (is_selected) {
-        // Selected tab: highlighted
-        buffer_set_cell_styled(buf, area.y, x, '[', COLOR_INDEX(14),
-                               COLOR_DEFAULT_INIT, ATTR_BOLD);
-        for (size_t j = 0; j < label_len && x + 1 + j < area.x + area.width;
-             j++) {
-          buffer_set_cell_styled(buf, area.y, x + 1 + j, label[j],
-                                 COLOR_INDEX(14), COLOR_DEFAULT_INIT,
-                                 ATTR_BOLD);
-        }
-        if (x + 1 + label_len < area.x + area.width) {
-          buffer_set_cell_styled(buf, area.y, x + 1 + label_len, ']',
-                                 COLOR_INDEX(14), COLOR_DEFAULT_INIT,
-                                 ATTR_BOLD);
-        }
-      } else {
-        // Unselected tab: dimmed
-        buffer_set_cell_styled(buf, area.y, x, ' ', COLOR_INDEX(8),
-                               COLOR_DEFAULT_INIT, ATTR_NONE);
-        for (size_t j = 0; j < label_len && x + 1 + j < area.x + area.width;
-             j++) {
-          buffer_set_cell_styled(buf, area.y, x + 1 + j, label[j],
-                                 COLOR_INDEX(8), COLOR_DEFAULT_INIT, ATTR_NONE);
-        }
-        if (x + 1 + label_len < area.x + area.width) {
-          buffer_set_cell_styled(buf, area.y, x + 1 + label_len, ' ',
-                                 COLOR_INDEX(8), COLOR_DEFAULT_INIT, ATTR_NONE);
-        }
+      // Draw tab with padding: selected is highlighted, others dimmed
+      Color fg = is_selected ? COLOR_INDEX(14) : COLOR_INDEX(8);
+      uint8_t attrs = is_selected ? ATTR_BOLD : ATTR_NONE;
+      size_t right = area.x + area.width;
+      buffer_set_cell_styled(buf, area.y, x, is_selected ? '[' : ' ', fg,
+                             COLOR_DEFAULT_INIT, attrs);
+      buffer_set_span_styled(buf, area.y, x + 1, label, label_len,
+                             right - (x + 1), fg, COLOR_DEFAULT_INIT, attrs);
+      if (x + 1 + label_len < right) {
+        buffer_set_cell_styled(buf, area.y, x + 1 + label_len,
+                               is_selected ? ']' : ' ', fg, COLOR_DEFAULT_INIT,
+                               attrs);
       }
 
       x += label_len + 3; // label + brackets/spaces + separator
@@ -733,3 +1125,749 @@ void widget_render(Widget *w, Buffer *buf, Rect area) {
   }
   }
 }
+
+// Retained mode
+// Each widget is matched to its previous-frame counterpart (by key, else by
+// position under the matched parent). A subtree whose inputs and size are
+// unchanged is copied from a snapshot of last frame's cells instead of
+// being drawn. Inputs are compared shallowly: data behind pointers must
+// not change in place unless the widget's version changes with it.
+// A VERSIONED widget is compared by its version alone, and any frame that
+// has one is reconciled this way even when retained mode is off.
+
+void ui_set_retained(int enabled) {
+  g_ui->retained = enabled;
+  g_ui->prev.count = 0;
+  g_ui->layout.count = 0; // The current tree may live in either arena
+  g_ui->snapshot_rows = 0;
+  g_ui->snapshot_cols = 0;
+}
+
+static int color_equal(Color a, Color b) {
+  return a.type == b.type && a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+// Shallow comparison of everything a widget draws from (children excluded)
+static int widget_inputs_equal(const Widget *a, const Widget *b) {
+  if (a->type != b->type || a->key != b->key || a->version != b->version ||
+      a->versioned != b->versioned ||
+      a->constraint.type != b->constraint.type ||
+      a->constraint.value1 != b->constraint.value1 ||
+      a->constraint.value2 != b->constraint.value2 ||
+      a->constraint.priority != b->constraint.priority)
+    return 0;
+
+  switch (a->type) {
+  case WIDGET_VBOX:
+  case WIDGET_HBOX:
+    return a->box.count == b->box.count;
+  case WIDGET_GRID:
+    if (a->grid.row_count != b->grid.row_count ||
+        a->grid.col_count != b->grid.col_count ||
+        a->grid.count != b->grid.count)
+      return 0;
+    for (size_t i = 0; i < a->grid.row_count; i++) {
+      const Constraint *x = &a->grid.rows[i], *y = &b->grid.rows[i];
+      if (x->type != y->type || x->value1 != y->value1 ||
+          x->value2 != y->value2 || x->priority != y->priority)
+        return 0;
+    }
+    for (size_t i = 0; i < a->grid.col_count; i++) {
+      const Constraint *x = &a->grid.cols[i], *y = &b->grid.cols[i];
+      if (x->type != y->type || x->value1 != y->value1 ||
+          x->value2 != y->value2 || x->priority != y->priority)
+        return 0;
+    }
+    for (size_t i = 0; i < a->grid.count; i++) {
+      const GridCell *x = &a->grid.cells[i], *y = &b->grid.cells[i];
+      if (x->row != y->row || x->col != y->col ||
+          x->row_span != y->row_span || x->col_span != y->col_span)
+        return 0;
+    }
+    return 1;
+  case WIDGET_TEXT:
+    return a->text.text == b->text.text &&
+           a->text.length == b->text.length &&
+           a->text.first_line == b->text.first_line;
+  case WIDGET_BLOCK:
+    return a->block.title == b->block.title &&
+           !a->block.child == !b->block.child;
+  case WIDGET_LIST:
+    return a->list.items == b->list.items &&
+           a->list.colors == b->list.colors &&
+           a->list.count == b->list.count &&
+           a->list.selected == b->list.selected &&
+           a->list.item_fn == b->list.item_fn &&
+           a->list.userdata == b->list.userdata &&
+           a->list.scroll == b->list.scroll &&
+           a->list.offset == b->list.offset;
+  case WIDGET_VLINE:
+  case WIDGET_HLINE:
+    return 1;
+  case WIDGET_INPUT:
+    return a->input.text == b->input.text &&
+           a->input.cursor == b->input.cursor &&
+           a->input.prompt == b->input.prompt;
+  case WIDGET_GAUGE:
+    return a->gauge.value == b->gauge.value &&
+           a->gauge.label == b->gauge.label &&
+           color_equal(a->gauge.color, b->gauge.color);
+  case WIDGET_SPARKLINE:
+    return a->sparkline.data == b->sparkline.data &&
+           a->sparkline.count == b->sparkline.count &&
+           a->sparkline.series == b->sparkline.series &&
+           a->sparkline.total == b->sparkline.total &&
+           color_equal(a->sparkline.color, b->sparkline.color);
+  case WIDGET_TABLE:
+    return a->table.headers == b->table.headers &&
+           a->table.rows == b->table.rows &&
+           a->table.col_count == b->table.col_count &&
+           a->table.row_count == b->table.row_count &&
+           a->table.widths == b->table.widths &&
+           a->table.cell_fn == b->table.cell_fn &&
+           a->table.userdata == b->table.userdata &&
+           a->table.selected == b->table.selected &&
+           a->table.state == b->table.state &&
+           a->table.row_offset == b->table.row_offset &&
+           a->table.col_offset == b->table.col_offset;
+  case WIDGET_LOG:
+    return a->log.ring == b->log.ring && a->log.state == b->log.state &&
+           a->log.total == b->log.total && a->log.top == b->log.top &&
+           a->log.hold == b->log.hold;
+  case WIDGET_CHECKBOX:
+    return a->checkbox.items == b->checkbox.items &&
+           a->checkbox.checked == b->checkbox.checked &&
+           a->checkbox.count == b->checkbox.count &&
+           a->checkbox.selected == b->checkbox.selected;
+  case WIDGET_PROGRESS:
+    return a->progress.value == b->progress.value &&
+           a->progress.label == b->progress.label &&
+           a->progress.show_percent == b->progress.show_percent;
+  case WIDGET_TABS:
+    return a->tabs.labels == b->tabs.labels &&
+           a->tabs.count == b->tabs.count &&
+           a->tabs.selected == b->tabs.selected;
+  }
+  return 0;
+}
+
+static size_t key_slot(uint32_t key, size_t mask) {
+  return (key * 2654435761u) & mask;
+}
+
+static Widget *key_lookup(const FrameLayout *l, uint32_t key) {
+  if (!l->keys)
+    return NULL;
+  for (size_t i = key_slot(key, l->key_mask);; i = (i + 1) & l->key_mask) {
+    if (!l->keys[i] || l->keys[i]->key == key)
+      return l->keys[i];
+  }
+}
+
+// Previous-frame counterpart of a child, given the widget at the same
+// position under the parent's counterpart
+static Widget *match_child(const Widget *child, Widget *old_child) {
+  if (child->key != 0)
+    return key_lookup(&g_ui->prev, child->key);
+  return (old_child && old_child->key == 0) ? old_child : NULL;
+}
+
+// Per-widget retained flags
+#define RETAIN_CLEAN 1  // Subtree identical to last frame's counterpart
+#define RETAIN_SHARED 2 // Overlaps a sibling: only reusable with its parent
+
+// A laid-out child is unchanged if it is clean and still sits where its
+// counterpart sat; a child without area must have had none before either
+static int child_unchanged(const Widget *child, const Widget *old_child) {
+  if (!old_child || g_ui->layout.match[child->id] != old_child)
+    return 0;
+  if (rect_is_empty(g_ui->layout.rects[child->id]))
+    return rect_is_empty(g_ui->prev.rects[old_child->id]);
+  return g_ui->layout.clean[child->id] & RETAIN_CLEAN;
+}
+
+// Track ranges a grid cell covers, clamped to the grid
+// Returns 0 if the cell lies outside the grid
+static int grid_cell_tracks(const Widget *w, const GridCell *cell,
+                            size_t *last_row, size_t *last_col) {
+  size_t nr = w->grid.row_count;
+  size_t nc = w->grid.col_count;
+  if (cell->row >= nr || cell->col >= nc)
+    return 0;
+  size_t rows = cell->row_span ? cell->row_span : 1;
+  size_t cols = cell->col_span ? cell->col_span : 1;
+  *last_row = cell->row + rows < nr ? cell->row + rows : nr;
+  *last_col = cell->col + cols < nc ? cell->col + cols : nc;
+  return 1;
+}
+
+// Number of cells covering each track cell of a grid (counting stops at 2)
+// Returns NULL if the frame arena is exhausted
+static uint8_t *grid_owners(const Widget *w) {
+  size_t nc = w->grid.col_count;
+  uint8_t *owners = arena_alloc(g_ui->arena, w->grid.row_count * nc);
+  if (!owners)
+    return NULL;
+  memset(owners, 0, w->grid.row_count * nc);
+
+  for (size_t k = 0; k < w->grid.count; k++) {
+    const GridCell *cell = &w->grid.cells[k];
+    size_t last_row, last_col;
+    if (!grid_cell_tracks(w, cell, &last_row, &last_col))
+      continue;
+    for (size_t r = cell->row; r < last_row; r++) {
+      for (size_t c = cell->col; c < last_col; c++) {
+        if (owners[r * nc + c] < 2)
+          owners[r * nc + c]++;
+      }
+    }
+  }
+  return owners;
+}
+
+// Whether two cells of a grid cover the same track cell
+static int grid_cells_overlap(const Widget *w) {
+  uint8_t *owners = grid_owners(w);
+  size_t cells = w->grid.row_count * w->grid.col_count;
+  for (size_t i = 0; i < cells && owners; i++) {
+    if (owners[i] > 1)
+      return 1;
+  }
+  return !owners; // Assume the worst when out of memory
+}
+
+// Flag grid cells whose tracks overlap another cell's: copying one of them
+// alone would also copy (or erase) what its neighbour drew there
+static void mark_shared_cells(const Widget *w) {
+  size_t nc = w->grid.col_count;
+  uint8_t *owners = grid_owners(w);
+
+  for (size_t k = 0; k < w->grid.count; k++) {
+    const GridCell *cell = &w->grid.cells[k];
+    size_t last_row, last_col;
+    if (!grid_cell_tracks(w, cell, &last_row, &last_col))
+      continue;
+    int shared = !owners;
+    for (size_t r = cell->row; r < last_row && !shared; r++) {
+      for (size_t c = cell->col; c < last_col; c++) {
+        if (owners[r * nc + c] > 1)
+          shared = 1;
+      }
+    }
+    if (shared)
+      g_ui->layout.clean[cell->widget->id] |= RETAIN_SHARED;
+  }
+}
+
+// Fill in clean flags, children before parents
+// parent holds the order index of each entry's parent (root: itself)
+static void mark_clean(const uint32_t *parent) {
+  for (size_t i = g_ui->layout.count; i > 0; i--) {
+    Widget *w = g_ui->layout.order[i - 1];
+    Widget *old = g_ui->layout.match[w->id];
+    Rect r = g_ui->layout.rects[w->id];
+    int clean = old && old->id < g_ui->prev.capacity &&
+                g_ui->prev.rects[old->id].width == r.width &&
+                g_ui->prev.rects[old->id].height == r.height;
+    int layout_only = w->type == WIDGET_VBOX || w->type == WIDGET_HBOX ||
+                      w->type == WIDGET_GRID;
+
+    if (w->versioned) {
+      // The version stands for the whole subtree: children are not compared
+      clean = clean && old->versioned && old->type == w->type &&
+              old->version == w->version;
+      if (w->type == WIDGET_GRID)
+        mark_shared_cells(w);
+      if (clean)
+        g_ui->layout.clean[w->id] |= RETAIN_CLEAN;
+      continue;
+    }
+
+    // Outside retained mode data behind pointers may change in place, so
+    // only widgets that draw nothing themselves are compared
+    clean = clean && (g_ui->retained || layout_only) &&
+            widget_inputs_equal(w, old);
+
+    // Short-circuits before touching old unless the inputs matched
+    if (w->type == WIDGET_VBOX || w->type == WIDGET_HBOX) {
+      for (size_t k = 0; k < w->box.count && clean; k++) {
+        clean = child_unchanged(w->box.children[k], old->box.children[k]);
+      }
+    } else if (w->type == WIDGET_GRID) {
+      mark_shared_cells(w);
+      for (size_t k = 0; k < w->grid.count && clean; k++) {
+        clean = child_unchanged(w->grid.cells[k].widget,
+                                old->grid.cells[k].widget);
+      }
+    } else if (w->type == WIDGET_BLOCK && w->block.child && clean) {
+      clean = child_unchanged(w->block.child, old->block.child);
+    }
+    if (clean)
+      g_ui->layout.clean[w->id] |= RETAIN_CLEAN;
+  }
+
+  // Everything inside a shared cell shares its area too
+  for (size_t i = 1; i < g_ui->layout.count; i++) {
+    if (g_ui->layout.clean[g_ui->layout.order[parent[i]]->id] & RETAIN_SHARED)
+      g_ui->layout.clean[g_ui->layout.order[i]->id] |= RETAIN_SHARED;
+  }
+}
+
+// Record every keyed widget for lookup by the next frame
+static void build_key_table(void) {
+  g_ui->layout.keys = NULL;
+  if (g_ui->keyed_count == 0)
+    return;
+
+  size_t size = 8;
+  while (size < g_ui->keyed_count * 2)
+    size *= 2;
+  Widget **keys = arena_alloc(g_ui->arena, sizeof(Widget *) * size);
+  if (!keys)
+    return;
+  memset(keys, 0, sizeof(Widget *) * size);
+
+  for (size_t i = 0; i < g_ui->layout.count; i++) {
+    Widget *w = g_ui->layout.order[i];
+    if (w->key == 0)
+      continue;
+    size_t slot = key_slot(w->key, size - 1);
+    while (keys[slot] && keys[slot]->key != w->key)
+      slot = (slot + 1) & (size - 1);
+    if (!keys[slot])
+      keys[slot] = w; // First widget with a key wins
+  }
+  g_ui->layout.keys = keys;
+  g_ui->layout.key_mask = size - 1;
+}
+
+// Copy a clean subtree's cells from its old position in the snapshot
+static void blit_snapshot(Buffer *buf, Rect from, Rect to) {
+  // Clip the destination, moving the source by the same amount
+  const BufferClip *clip = &buf->clip;
+  int top = to.y < clip->top ? clip->top : to.y;
+  int left = to.x < clip->left ? clip->left : to.x;
+  int bottom = to.y + to.height < clip->bottom ? to.y + to.height
+                                               : clip->bottom;
+  int right = to.x + to.width < clip->right ? to.x + to.width : clip->right;
+  int src_col = from.x + (left - to.x);
+  if (src_col + (right - left) > g_ui->snapshot_cols)
+    right = left + g_ui->snapshot_cols - src_col;
+  if (right <= left)
+    return;
+
+  for (int row = top; row < bottom; row++) {
+    int src_row = from.y + (row - to.y);
+    if (src_row >= g_ui->snapshot_rows)
+      break;
+    memcpy(&buf->cells[row * buf->cols + left],
+           &g_ui->snapshot[src_row * g_ui->snapshot_cols + src_col],
+           sizeof(Cell) * (right - left));
+  }
+}
+
+int widget_layout(Widget *root, Rect area) {
+  g_ui->layout.count = 0;
+  g_ui->layout.capacity = 0;
+  if (!root)
+    return 0;
+  if (root->id >= g_ui->widget_count)
+    return -1; // Built in an earlier frame
+
+  if (area.width != g_ui->last_root.width ||
+      area.height != g_ui->last_root.height) {
+    layout_cache_invalidate();
+    g_ui->last_root = area;
+  }
+
+  // A tree visits each widget once, so the stack never holds more than the
+  // widget count (the bounds only matter for widgets shared by two parents);
+  // split scratch is shared by all boxes and grids
+  size_t n = g_ui->widget_count;
+  size_t m = g_ui->max_children ? g_ui->max_children : 1;
+  Rect *rects = arena_alloc(g_ui->arena, sizeof(Rect) * n);
+  Widget **order = arena_alloc(g_ui->arena, sizeof(Widget *) * n);
+  Widget **stack = arena_alloc(g_ui->arena, sizeof(Widget *) * n);
+  Constraint *constraints = arena_alloc(g_ui->arena, sizeof(Constraint) * m);
+  Rect *areas = arena_alloc(g_ui->arena, sizeof(Rect) * m);
+  if (!rects || !order || !stack || !constraints || !areas)
+    return -1;
+  memset(rects, 0, sizeof(Rect) * n);
+
+  // Retained or parallel rendering: each entry's parent, for subtree
+  // extents; retained mode (or VERSIONED widgets): previous-frame matches
+  int retain = g_ui->retained || g_ui->versioned_count > 0;
+  Widget **match = NULL;
+  uint8_t *clean = NULL;
+  uint32_t *extent = NULL;
+  uint32_t *parent = NULL;
+  uint32_t *stack_parent = NULL;
+  if (retain || g_pool) {
+    extent = arena_alloc(g_ui->arena, sizeof(uint32_t) * n);
+    parent = arena_alloc(g_ui->arena, sizeof(uint32_t) * n);
+    stack_parent = arena_alloc(g_ui->arena, sizeof(uint32_t) * n);
+    if (!extent || !parent || !stack_parent)
+      return -1;
+  }
+  if (retain) {
+    match = arena_alloc(g_ui->arena, sizeof(Widget *) * n);
+    clean = arena_alloc(g_ui->arena, n);
+    if (!match || !clean)
+      return -1;
+    memset(match, 0, sizeof(Widget *) * n);
+    memset(clean, 0, n);
+    match[root->id] = g_ui->prev.count > 0 ? g_ui->prev.root : NULL;
+  }
+
+  size_t count = 0;
+  size_t top = 0;
+  rects[root->id] = area;
+  stack[top++] = root;
+  if (stack_parent)
+    stack_parent[0] = 0;
+
+  while (top > 0 && count < n) {
+    Widget *w = stack[--top];
+    Rect r = rects[w->id];
+    if (rect_is_empty(r))
+      continue;
+    if (parent)
+      parent[count] = stack_parent[top];
+    uint32_t self = (uint32_t)count;
+    order[count++] = w;
+
+    // Counterpart of w, if it has the same shape (for positional matches)
+    Widget *old = match ? match[w->id] : NULL;
+    if (old && old->type != w->type)
+      old = NULL;
+
+    if (w->type == WIDGET_VBOX || w->type == WIDGET_HBOX) {
+      Direction dir =
+          (w->type == WIDGET_VBOX) ? DIRECTION_VERTICAL : DIRECTION_HORIZONTAL;
+      size_t k = w->box.count;
+      if (k == 0)
+        continue;
+
+      for (size_t i = 0; i < k; i++) {
+        constraints[i] = w->box.children[i]->constraint;
+      }
+      if (layout_split_cached(r, dir, constraints, k, areas) < 0)
+        continue; // Layout failed: children stay unplaced
+
+      // Push in reverse so children are drawn first to last
+      for (size_t i = k; i > 0 && top < n; i--) {
+        Widget *child = w->box.children[i - 1];
+        rects[child->id] = areas[i - 1];
+        if (match)
+          match[child->id] = match_child(
+              child, old && i <= old->box.count ? old->box.children[i - 1]
+                                                : NULL);
+        if (stack_parent)
+          stack_parent[top] = self;
+        stack[top++] = child;
+      }
+    } else if (w->type == WIDGET_GRID) {
+      // Solve each axis once; every cell reuses the same tracks
+      size_t nr = w->grid.row_count;
+      size_t nc = w->grid.col_count;
+      Rect *row_rects = areas;
+      Rect *col_rects = areas + nr;
+      if (nr == 0 || nc == 0 ||
+          layout_split_cached(r, DIRECTION_VERTICAL, w->grid.rows, nr,
+                              row_rects) < 0 ||
+          layout_split_cached(r, DIRECTION_HORIZONTAL, w->grid.cols, nc,
+                              col_rects) < 0)
+        continue;
+
+      for (size_t i = w->grid.count; i > 0 && top < n; i--) {
+        const GridCell *cell = &w->grid.cells[i - 1];
+        if (cell->row >= nr || cell->col >= nc)
+          continue; // Outside the grid
+        size_t last_row = cell->row + (cell->row_span ? cell->row_span : 1);
+        size_t last_col = cell->col + (cell->col_span ? cell->col_span : 1);
+        last_row = (last_row < nr ? last_row : nr) - 1;
+        last_col = (last_col < nc ? last_col : nc) - 1;
+
+        uint16_t x = col_rects[cell->col].x;
+        uint16_t y = row_rects[cell->row].y;
+        uint16_t right = col_rects[last_col].x + col_rects[last_col].width;
+        uint16_t bottom = row_rects[last_row].y + row_rects[last_row].height;
+        rects[cell->widget->id] =
+            (Rect){.x = x, .y = y, .width = right - x, .height = bottom - y};
+        if (match)
+          match[cell->widget->id] = match_child(
+              cell->widget,
+              old && i <= old->grid.count ? old->grid.cells[i - 1].widget
+                                          : NULL);
+        if (stack_parent)
+          stack_parent[top] = self;
+        stack[top++] = cell->widget;
+      }
+    } else if (w->type == WIDGET_BLOCK) {
+      Widget *child = w->block.child;
+      if (child && r.width > 2 && r.height > 2 && top < n) {
+        rects[child->id] = (Rect){.x = r.x + 1,
+                                  .y = r.y + 1,
+                                  .width = r.width - 2,
+                                  .height = r.height - 2};
+        if (match)
+          match[child->id] = match_child(child, old ? old->block.child : NULL);
+        if (stack_parent)
+          stack_parent[top] = self;
+        stack[top++] = child;
+      }
+    }
+  }
+
+  g_ui->layout.rects = rects;
+  g_ui->layout.order = order;
+  g_ui->layout.count = count;
+  g_ui->layout.capacity = n;
+  g_ui->layout.root = root;
+  g_ui->layout.match = match;
+  g_ui->layout.clean = clean;
+  g_ui->layout.extent = extent;
+  g_ui->layout.keys = NULL;
+  if (extent) {
+    // Children come after their parent, so sum subtrees back to front
+    for (size_t i = 0; i < count; i++) {
+      extent[i] = 1;
+    }
+    for (size_t i = count; i > 1; i--) {
+      extent[parent[i - 1]] += extent[i - 1];
+    }
+  }
+  if (retain) {
+    mark_clean(parent);
+    build_key_table();
+  }
+  return 0;
+}
+
+// Whether the subtree at order index i is unchanged and its old cells were
+// its own, so they can be copied from the snapshot
+static int subtree_reusable(size_t i, int reuse) {
+  Widget *w = g_ui->layout.order[i];
+  Widget *old = reuse ? g_ui->layout.match[w->id] : NULL;
+  return old && g_ui->layout.clean[w->id] == RETAIN_CLEAN &&
+         !(g_ui->prev.clean[old->id] & RETAIN_SHARED);
+}
+
+// Draw the order entries [begin, end), which must hold whole subtrees
+static void draw_range(Buffer *buf, size_t begin, size_t end, int reuse,
+                       Arena *scratch) {
+  for (size_t i = begin; i < end;) {
+    Widget *w = g_ui->layout.order[i];
+    if (subtree_reusable(i, reuse)) {
+      // Copy the whole subtree and skip its descendants
+      Widget *old = g_ui->layout.match[w->id];
+      blit_snapshot(buf, g_ui->prev.rects[old->id], g_ui->layout.rects[w->id]);
+      i += g_ui->layout.extent[i];
+      continue;
+    }
+    // Clip to the widget's area so it cannot overdraw its siblings
+    Rect area = g_ui->layout.rects[w->id];
+    int clipped =
+        buffer_push_clip(buf, area.y, area.x, area.height, area.width) == 0;
+    render_self(w, buf, area, scratch);
+    if (clipped)
+      buffer_pop_clip(buf);
+    i++;
+  }
+}
+
+// Parallel rendering
+// The tree is cut into subtrees whose areas are disjoint. Widgets above
+// the cut are drawn first; the subtrees are then drawn as pool tasks, each
+// into its own view of the buffer (sharing the cells, not the clip) with
+// its own scratch arena.
+#define RENDER_TASK_MIN_CELLS 4096 // Subtrees this cheap are not cut up
+
+typedef struct {
+  size_t begin; // Order range of the subtree
+  size_t end;
+  size_t cost; // Cells it draws
+} RenderTask;
+
+typedef struct {
+  Buffer *buf;
+  const RenderTask *tasks;
+  int reuse;
+} RenderJob;
+
+static Arena *g_scratch = NULL; // One per helper thread
+
+int ui_set_render_threads(size_t threads) {
+  size_t current = g_pool ? task_pool_threads(g_pool) : 1;
+  if (threads < 1)
+    threads = 1;
+  if (threads == current)
+    return 0;
+
+  TaskPool *pool = NULL;
+  Arena *scratch = NULL;
+  if (threads > 1) {
+    pool = task_pool_create(threads);
+    scratch = calloc(threads - 1, sizeof(Arena));
+    if (!pool || !scratch) {
+      task_pool_destroy(pool);
+      free(scratch);
+      return -1;
+    }
+  }
+
+  for (size_t k = 0; k + 1 < current; k++) {
+    arena_release(&g_scratch[k]);
+  }
+  free(g_scratch);
+  task_pool_destroy(g_pool);
+  g_pool = pool;
+  g_scratch = scratch;
+  return 0;
+}
+
+static int rect_contains(Rect outer, Rect inner) {
+  return inner.x >= outer.x && inner.y >= outer.y &&
+         inner.x + inner.width <= outer.x + outer.width &&
+         inner.y + inner.height <= outer.y + outer.height;
+}
+
+static int compare_task_cost(const void *a, const void *b) {
+  size_t ca = ((const RenderTask *)a)->cost;
+  size_t cb = ((const RenderTask *)b)->cost;
+  return (ca < cb) - (ca > cb); // Costliest first
+}
+
+// Cut the laid-out tree into tasks, drawing the widgets above the cut
+// Returns the task count, or 0 (with nothing drawn) to draw it serially
+static size_t plan_render_tasks(Buffer *buf, int reuse, RenderTask **out) {
+  size_t n = g_ui->layout.count;
+  size_t *cost = arena_alloc(g_ui->arena, sizeof(size_t) * n);
+  size_t *stack = arena_alloc(g_ui->arena, sizeof(size_t) * n);
+  RenderTask *tasks = arena_alloc(g_ui->arena, sizeof(RenderTask) * n);
+  if (n == 0 || !cost || !stack || !tasks)
+    return 0;
+
+  // Cost of each subtree, children before parents. A subtree is only
+  // independent if all of it lies inside its root's area.
+  for (size_t i = n; i > 0; i--) {
+    size_t k = i - 1;
+    Widget *w = g_ui->layout.order[k];
+    Rect r = g_ui->layout.rects[w->id];
+    cost[k] = (size_t)r.width * r.height;
+    if (subtree_reusable(k, reuse))
+      continue;
+    if (w->type == WIDGET_VBOX || w->type == WIDGET_HBOX ||
+        w->type == WIDGET_GRID)
+      cost[k] = 0; // Containers draw nothing themselves
+    for (size_t c = k + 1; c < k + g_ui->layout.extent[k];
+         c += g_ui->layout.extent[c]) {
+      if (!rect_contains(r, g_ui->layout.rects[g_ui->layout.order[c]->id]))
+        return 0;
+      cost[k] += cost[c];
+    }
+  }
+  if (cost[0] < 2 * RENDER_TASK_MIN_CELLS)
+    return 0;
+
+  // Cut below every costly widget whose children cannot overlap
+  size_t count = 0;
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    size_t k = stack[--top];
+    Widget *w = g_ui->layout.order[k];
+    size_t end = k + g_ui->layout.extent[k];
+    if (cost[k] < RENDER_TASK_MIN_CELLS || end == k + 1 ||
+        subtree_reusable(k, reuse) ||
+        (w->type == WIDGET_GRID && grid_cells_overlap(w))) {
+      tasks[count++] = (RenderTask){k, end, cost[k]};
+      continue;
+    }
+    draw_range(buf, k, k + 1, reuse, g_ui->arena);
+    for (size_t c = k + 1; c < end; c += g_ui->layout.extent[c]) {
+      stack[top++] = c;
+    }
+  }
+
+  qsort(tasks, count, sizeof(RenderTask), compare_task_cost);
+  *out = tasks;
+  return count;
+}
+
+static void render_task(void *ctx, size_t task, size_t worker) {
+  const RenderJob *job = ctx;
+  const RenderTask *t = &job->tasks[task];
+
+  // The calling thread owns the frame arena; helpers reset their own
+  Arena *scratch = g_ui->arena;
+  if (worker > 0) {
+    scratch = &g_scratch[worker - 1];
+    arena_reset(scratch);
+  }
+  Buffer view = *job->buf;
+  draw_range(&view, t->begin, t->end, job->reuse, scratch);
+}
+
+void widget_draw(Buffer *buf) {
+  UiState *ui = g_ui;
+
+  // Reuse needs last frame's cells at the same buffer size
+  int reuse = ui->layout.clean && ui->prev.clean && ui->snapshot &&
+              ui->prev.count > 0 && ui->snapshot_rows == buf->rows &&
+              ui->snapshot_cols == buf->cols;
+
+  RenderTask *tasks = NULL;
+  size_t task_count = g_pool && ui->layout.extent
+                          ? plan_render_tasks(buf, reuse, &tasks)
+                          : 0;
+  if (task_count > 0) {
+    RenderJob job = {buf, tasks, reuse};
+    task_pool_run(g_pool, render_task, &job, task_count);
+  } else {
+    draw_range(buf, 0, ui->layout.count, reuse, ui->arena);
+  }
+
+  // Keep the cells of a reconciled frame for the next one to copy from
+  if (ui->layout.clean) {
+    size_t cells = (size_t)buf->rows * buf->cols;
+    if (buf->rows != ui->snapshot_rows || buf->cols != ui->snapshot_cols) {
+      Cell *grown = realloc(ui->snapshot, sizeof(Cell) * cells);
+      if (!grown) {
+        ui->snapshot_rows = ui->snapshot_cols = 0;
+        return;
+      }
+      ui->snapshot = grown;
+      ui->snapshot_rows = buf->rows;
+      ui->snapshot_cols = buf->cols;
+    }
+    memcpy(ui->snapshot, buf->cells, sizeof(Cell) * cells);
+  }
+}
+
+int widget_get_rect(const Widget *w, Rect *out) {
+  if (!w || w->id >= g_ui->layout.capacity)
+    return -1;
+  Rect r = g_ui->layout.rects[w->id];
+  if (rect_is_empty(r))
+    return -1;
+  *out = r;
+  return 0;
+}
+
+Widget *widget_at(uint16_t row, uint16_t col) {
+  // Later widgets are drawn on top of (and nested inside) earlier ones
+  for (size_t i = g_ui->layout.count; i > 0; i--) {
+    Widget *w = g_ui->layout.order[i - 1];
+    Rect r = g_ui->layout.rects[w->id];
+    if (col >= r.x && col - r.x < r.width && row >= r.y &&
+        row - r.y < r.height)
+      return w;
+  }
+  return NULL;
+}
+
+void widget_render(Widget *w, Buffer *buf, Rect area) {
+  if (widget_layout(w, area) == 0)
+    widget_draw(buf);
+}